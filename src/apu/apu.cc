@@ -0,0 +1,544 @@
+#include "apu.h"
+#include <algorithm>
+
+namespace {
+
+// Bits that read back as 1 in 0xFF10-0xFF2F: write-only and unused bits
+constexpr uint8_t read_masks[0x20] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,  // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,  // NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,  // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,  // NR41-NR44
+    0x00, 0x00, 0x70,              // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// NR10-NR52 after the boot ROM
+constexpr uint8_t boot_registers[0x17] = {
+    0x80, 0xBF, 0xF3, 0xFF, 0xBF,
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,
+    0x77, 0xF3, 0xF1
+};
+
+// Pulse output per duty step, bit n for step n
+constexpr uint8_t duty_patterns[4] = { 0x80, 0x81, 0xE1, 0x7E };
+constexpr uint8_t duty_high_steps[4] = { 1, 2, 4, 6 };
+
+constexpr int32_t gain_unit = 64; // 4 channels x 15 x volume 8 x 64 stays within 16 bits
+
+constexpr std::size_t buffer_seconds_divisor = 4;
+
+constexpr int wave_channel = 2;
+constexpr int noise_channel = 3;
+
+}
+
+APU::APU(MachineState& state, MMU& mmu):
+    state_(state),
+    mmu_(mmu),
+    left_(clock_rate, default_sample_rate, default_sample_rate / buffer_seconds_divisor, sequencer_period),
+    right_(clock_rate, default_sample_rate, default_sample_rate / buffer_seconds_divisor, sequencer_period)
+{
+    set_averaging_limits();
+}
+
+void APU::connect() {
+    for (uint8_t reg = io::NR10; reg < io::WAVE; reg++) {
+        mmu_.map_io(0xFF00 | reg, read_register, reg <= io::NR52 ? write_register : nullptr, this, stable_until);
+    }
+    for (uint8_t reg = io::WAVE; reg < io::WAVE + 0x10; reg++) {
+        mmu_.map_io(0xFF00 | reg, nullptr, write_register, this);
+    }
+}
+
+void APU::skip_boot_rom() {
+    std::copy(std::begin(boot_registers), std::end(boot_registers), state_.high + io::NR10);
+    ApuState& apu = state_.apu;
+    apu = ApuState();
+    apu.time = now();
+    // the chime has faded out, but channel 1 still reports as on
+    apu.channels[0].enabled = true;
+    apu.channels[0].next_edge = apu.time;
+    restart_output();
+}
+
+void APU::copy_output(const APU& other) {
+    enabled_ = other.enabled_;
+    if (sample_rate_ != other.sample_rate_) {
+        set_sample_rate(other.sample_rate_);
+    } else {
+        restart_output();
+    }
+}
+
+void APU::hold_output() {
+    if (!held_) {
+        held_.reset(new HeldOutput{left_, right_, {}, {}, {}});
+    } else {
+        held_->left = left_;
+        held_->right = right_;
+    }
+    std::copy(std::begin(levels_), std::end(levels_), held_->levels);
+    std::copy(std::begin(left_gain_), std::end(left_gain_), held_->left_gain);
+    std::copy(std::begin(right_gain_), std::end(right_gain_), held_->right_gain);
+}
+
+void APU::restore_output() {
+    left_ = held_->left;
+    right_ = held_->right;
+    std::copy(std::begin(held_->levels), std::end(held_->levels), levels_);
+    std::copy(std::begin(held_->left_gain), std::end(held_->left_gain), left_gain_);
+    std::copy(std::begin(held_->right_gain), std::end(held_->right_gain), right_gain_);
+}
+
+void APU::set_enabled(bool enabled) {
+    if (enabled == enabled_) {
+        return;
+    }
+    catch_up(now());
+    enabled_ = enabled;
+    if (enabled) {
+        // waveforms stood still while disabled, restart them from here
+        for (ApuState::Channel& channel : state_.apu.channels) {
+            channel.next_edge = std::max(channel.next_edge, state_.apu.time);
+        }
+        restart_output();
+    }
+}
+
+void APU::set_sample_rate(unsigned rate) {
+    sample_rate_ = rate;
+    std::size_t capacity = rate / buffer_seconds_divisor;
+    left_ = BlipBuffer(clock_rate, rate, capacity, sequencer_period);
+    right_ = BlipBuffer(clock_rate, rate, capacity, sequencer_period);
+    set_averaging_limits();
+    restart_output();
+}
+
+// A pulse spends 8 steps per cycle and a wave 32; anything above the
+// output Nyquist frequency is inaudible
+void APU::set_averaging_limits() {
+    min_pulse_period_ = static_cast<uint64_t>(clock_rate / (4.0 * sample_rate_));
+    min_wave_period_ = static_cast<uint64_t>(clock_rate / (16.0 * sample_rate_));
+}
+
+std::size_t APU::samples_available() {
+    catch_up(now());
+    return left_.samples_available();
+}
+
+std::size_t APU::read_samples(int16_t* out, std::size_t count) {
+    catch_up(now());
+    count = left_.read_samples(out, count, 2);
+    right_.read_samples(out + 1, count, 2);
+    return count;
+}
+
+/* Registers */
+uint8_t APU::read_register(void* context, uint16_t address) {
+    APU& apu = *static_cast<APU*>(context);
+    uint8_t reg = address & 0xFF;
+    const uint8_t* high = apu.state_.high;
+    if (reg != io::NR52) {
+        return high[reg] | read_masks[reg - io::NR10];
+    }
+    // length counters and sweep may have stopped channels since the last write
+    apu.catch_up(apu.now());
+    uint8_t status = 0;
+    for (int channel = 0; channel < 4; channel++) {
+        status |= apu.state_.apu.channels[channel].enabled << channel;
+    }
+    return 0x70 | (high[io::NR52] & 0x80) | status;
+}
+
+// Channels only stop on writes and frame sequencer steps
+uint64_t APU::stable_until(void*, uint16_t, uint64_t now) {
+    constexpr uint64_t step_cycles = sequencer_period / 4;
+    return (now / step_cycles + 1) * step_cycles;
+}
+
+void APU::write_register(void* context, uint16_t address, uint8_t value) {
+    APU& apu = *static_cast<APU*>(context);
+    apu.catch_up(apu.now());
+    apu.write(address & 0xFF, value);
+}
+
+void APU::write(uint8_t reg, uint8_t value) {
+    uint8_t* high = state_.high;
+    ApuState& apu = state_.apu;
+    if (reg >= io::WAVE) {
+        high[reg] = value;
+        refresh_levels(apu.time);
+        return;
+    }
+    bool powered = high[io::NR52] & 0x80;
+    if (reg == io::NR52) {
+        high[io::NR52] = value & 0x80;
+        if (powered && !(value & 0x80)) {
+            // powering off clears every sound register but wave RAM
+            std::fill(high + io::NR10, high + io::NR52, 0);
+            for (ApuState::Channel& channel : apu.channels) {
+                channel.enabled = false;
+            }
+            update_gains(apu.time);
+            refresh_levels(apu.time);
+        } else if (!powered && (value & 0x80)) {
+            apu.sequencer_step = 0;
+        }
+        return;
+    }
+    if (!powered) {
+        return; // registers ignore writes while the APU is off
+    }
+    high[reg] = value;
+    if (reg == io::NR50 || reg == io::NR51) {
+        update_gains(apu.time);
+        return;
+    }
+
+    int channel = (reg - io::NR10) / 5;
+    ApuState::Channel& state = apu.channels[channel];
+    switch ((reg - io::NR10) % 5) {
+        case 1:
+            state.length = channel == wave_channel ? 256 - value : 64 - (value & 0x3F);
+            break;
+        case 4:
+            if (value & 0x80) {
+                trigger(channel);
+            }
+            break;
+        default:
+            break;
+    }
+    if (!dac_on(channel)) {
+        state.enabled = false;
+    }
+    refresh_levels(apu.time);
+}
+
+bool APU::dac_on(int channel) const {
+    const uint8_t* regs = state_.high + io::NR10 + channel * 5;
+    return channel == wave_channel ? regs[0] & 0x80 : regs[2] & 0xF8;
+}
+
+uint16_t APU::frequency(int channel) const {
+    const uint8_t* regs = state_.high + io::NR10 + channel * 5;
+    return static_cast<uint16_t>((regs[4] & 0x07) << 8 | regs[3]);
+}
+
+void APU::trigger(int channel) {
+    ApuState& apu = state_.apu;
+    ApuState::Channel& state = apu.channels[channel];
+    const uint8_t* regs = state_.high + io::NR10 + channel * 5;
+    state.enabled = dac_on(channel);
+    if (state.length == 0) {
+        state.length = channel == wave_channel ? 256 : 64;
+    }
+    state.next_edge = apu.time;
+    if (channel == wave_channel) {
+        state.position = 0;
+        return;
+    }
+    state.volume = regs[2] >> 4;
+    state.envelope_timer = regs[2] & 0x07;
+    if (channel == noise_channel) {
+        apu.lfsr = 0x7FFF;
+    }
+    if (channel == 0) {
+        uint8_t sweep = state_.high[io::NR10];
+        apu.sweep_frequency = frequency(0);
+        apu.sweep_timer = (sweep >> 4) & 0x07 ? (sweep >> 4) & 0x07 : 8;
+        apu.sweep_enabled = (sweep & 0x77) != 0;
+        if (sweep & 0x07) {
+            sweep_target();
+        }
+    }
+}
+
+/* Frame sequencer */
+void APU::catch_up(uint64_t now) {
+    ApuState& apu = state_.apu;
+    while (apu.time < now) {
+        uint64_t step_end = (apu.time / sequencer_period + 1) * sequencer_period;
+        uint64_t end = std::min(now, step_end);
+        if (enabled_) {
+            run_pulse(0, end);
+            run_pulse(1, end);
+            run_wave(end);
+            run_noise(end);
+            left_.end_frame(static_cast<uint32_t>(end - apu.time));
+            right_.end_frame(static_cast<uint32_t>(end - apu.time));
+        }
+        apu.time = end;
+        if (end == step_end && (state_.high[io::NR52] & 0x80)) {
+            clock_sequencer();
+            refresh_levels(end);
+        }
+    }
+}
+
+// Length counters on even steps, sweep on 2 and 6, envelopes on 7
+void APU::clock_sequencer() {
+    ApuState& apu = state_.apu;
+    uint8_t step = apu.sequencer_step;
+    apu.sequencer_step = (step + 1) & 7;
+
+    if (!(step & 1)) {
+        for (int channel = 0; channel < 4; channel++) {
+            ApuState::Channel& state = apu.channels[channel];
+            bool length_enabled = state_.high[io::NR10 + channel * 5 + 4] & 0x40;
+            if (length_enabled && state.length && --state.length == 0) {
+                state.enabled = false;
+            }
+        }
+    }
+    if (step == 2 || step == 6) {
+        clock_sweep();
+    }
+    if (step == 7) {
+        for (int channel : {0, 1, noise_channel}) {
+            ApuState::Channel& state = apu.channels[channel];
+            uint8_t envelope = state_.high[io::NR10 + channel * 5 + 2];
+            uint8_t period = envelope & 0x07;
+            if (!period) {
+                continue;
+            }
+            if (state.envelope_timer) {
+                state.envelope_timer--;
+            }
+            if (state.envelope_timer == 0) {
+                state.envelope_timer = period;
+                if ((envelope & 0x08) && state.volume < 15) {
+                    state.volume++;
+                } else if (!(envelope & 0x08) && state.volume > 0) {
+                    state.volume--;
+                }
+            }
+        }
+    }
+}
+
+void APU::clock_sweep() {
+    ApuState& apu = state_.apu;
+    if (apu.sweep_timer) {
+        apu.sweep_timer--;
+    }
+    if (apu.sweep_timer) {
+        return;
+    }
+    uint8_t sweep = state_.high[io::NR10];
+    uint8_t period = (sweep >> 4) & 0x07;
+    apu.sweep_timer = period ? period : 8;
+    if (!apu.sweep_enabled || !period) {
+        return;
+    }
+    uint16_t target = sweep_target();
+    if (target <= 2047 && (sweep & 0x07)) {
+        apu.sweep_frequency = target;
+        state_.high[io::NR13] = target & 0xFF;
+        state_.high[io::NR14] = static_cast<uint8_t>((state_.high[io::NR14] & 0xF8) | (target >> 8));
+        sweep_target(); // the next step's overflow check happens now
+    }
+}
+
+uint16_t APU::sweep_target() {
+    ApuState& apu = state_.apu;
+    uint8_t sweep = state_.high[io::NR10];
+    uint16_t delta = apu.sweep_frequency >> (sweep & 0x07);
+    uint16_t target = sweep & 0x08 ? apu.sweep_frequency - delta : apu.sweep_frequency + delta;
+    if (target > 2047) {
+        apu.channels[0].enabled = false;
+    }
+    return target;
+}
+
+/* Synthesis */
+void APU::run_pulse(int channel, uint64_t end) {
+    ApuState::Channel& state = state_.apu.channels[channel];
+    if (!state.enabled) {
+        return;
+    }
+    uint64_t period = (2048 - frequency(channel)) * 4u;
+    if (period < min_pulse_period_) {
+        if (state.next_edge < end) {
+            uint64_t steps = (end - state.next_edge) / period + 1;
+            state.position = (state.position + steps) & 7;
+            state.next_edge += steps * period;
+        }
+        set_level(channel, state_.apu.time, level(channel));
+        return;
+    }
+    while (state.next_edge < end) {
+        state.position = (state.position + 1) & 7;
+        set_level(channel, state.next_edge, level(channel));
+        state.next_edge += period;
+    }
+}
+
+void APU::run_wave(uint64_t end) {
+    ApuState::Channel& state = state_.apu.channels[wave_channel];
+    if (!state.enabled) {
+        return;
+    }
+    uint64_t period = (2048 - frequency(wave_channel)) * 2u;
+    if (period < min_wave_period_) {
+        if (state.next_edge < end) {
+            uint64_t steps = (end - state.next_edge) / period + 1;
+            state.position = (state.position + steps) & 31;
+            state.next_edge += steps * period;
+        }
+        set_level(wave_channel, state_.apu.time, level(wave_channel));
+        return;
+    }
+    while (state.next_edge < end) {
+        state.position = (state.position + 1) & 31;
+        set_level(wave_channel, state.next_edge, level(wave_channel));
+        state.next_edge += period;
+    }
+}
+
+void APU::run_noise(uint64_t end) {
+    ApuState& apu = state_.apu;
+    ApuState::Channel& state = apu.channels[noise_channel];
+    uint8_t polynomial = state_.high[io::NR43];
+    if (!state.enabled || (polynomial >> 4) >= 14) {
+        return; // shifts of 14 and 15 never clock the register
+    }
+    uint8_t divisor = polynomial & 0x07;
+    uint64_t period = static_cast<uint64_t>(divisor ? divisor * 16 : 8) << (polynomial >> 4);
+    bool short_mode = polynomial & 0x08;
+    while (state.next_edge < end) {
+        uint16_t bit = (apu.lfsr ^ (apu.lfsr >> 1)) & 1;
+        apu.lfsr = static_cast<uint16_t>((apu.lfsr >> 1) | (bit << 14));
+        if (short_mode) {
+            apu.lfsr = static_cast<uint16_t>((apu.lfsr & ~0x40) | (bit << 6));
+        }
+        set_level(noise_channel, state.next_edge, level(noise_channel));
+        state.next_edge += period;
+    }
+}
+
+// Current DAC input, 0-15
+uint8_t APU::level(int channel) const {
+    const ApuState& apu = state_.apu;
+    const ApuState::Channel& state = apu.channels[channel];
+    if (!state.enabled) {
+        return 0;
+    }
+    const uint8_t* high = state_.high;
+    switch (channel) {
+        case wave_channel: {
+            uint8_t volume_code = (high[io::NR32] >> 5) & 0x03;
+            if (!volume_code) {
+                return 0;
+            }
+            if ((2048 - frequency(wave_channel)) * 2u < min_wave_period_) {
+                unsigned sum = 0;
+                for (int i = 0; i < 16; i++) {
+                    sum += (high[io::WAVE + i] >> 4) + (high[io::WAVE + i] & 0x0F);
+                }
+                return static_cast<uint8_t>((sum / 32) >> (volume_code - 1));
+            }
+            uint8_t samples = high[io::WAVE + state.position / 2];
+            uint8_t sample = state.position & 1 ? samples & 0x0F : samples >> 4;
+            return sample >> (volume_code - 1);
+        }
+        case noise_channel:
+            return apu.lfsr & 1 ? 0 : state.volume;
+        default: {
+            uint8_t duty = high[io::NR10 + channel * 5 + 1] >> 6;
+            if ((2048 - frequency(channel)) * 4u < min_pulse_period_) {
+                return static_cast<uint8_t>(state.volume * duty_high_steps[duty] / 8);
+            }
+            return (duty_patterns[duty] >> state.position) & 1 ? state.volume : 0;
+        }
+    }
+}
+
+void APU::set_level(int channel, uint64_t t, uint8_t level) {
+    if (!enabled_ || level == levels_[channel]) {
+        return;
+    }
+    int32_t delta = level - levels_[channel];
+    levels_[channel] = level;
+    uint32_t clock = static_cast<uint32_t>(t - state_.apu.time);
+    if (left_gain_[channel]) {
+        left_.add_delta(clock, delta * left_gain_[channel]);
+    }
+    if (right_gain_[channel]) {
+        right_.add_delta(clock, delta * right_gain_[channel]);
+    }
+}
+
+void APU::refresh_levels(uint64_t t) {
+    for (int channel = 0; channel < 4; channel++) {
+        set_level(channel, t, level(channel));
+    }
+}
+
+// NR50 master volume and NR51 panning scale each channel per side
+void APU::update_gains(uint64_t t) {
+    uint8_t volume = state_.high[io::NR50];
+    uint8_t panning = state_.high[io::NR51];
+    uint32_t clock = static_cast<uint32_t>(t - state_.apu.time);
+    for (int channel = 0; channel < 4; channel++) {
+        int32_t left = (panning >> (channel + 4)) & 1 ? (((volume >> 4) & 0x07) + 1) * gain_unit : 0;
+        int32_t right = (panning >> channel) & 1 ? ((volume & 0x07) + 1) * gain_unit : 0;
+        if (enabled_ && levels_[channel]) {
+            left_.add_delta(clock, levels_[channel] * (left - left_gain_[channel]));
+            right_.add_delta(clock, levels_[channel] * (right - right_gain_[channel]));
+        }
+        left_gain_[channel] = left;
+        right_gain_[channel] = right;
+    }
+}
+
+// Empties the buffers and restarts the synthesizer from silence at the
+// current levels
+void APU::restart_output() {
+    left_.clear();
+    right_.clear();
+    std::fill(std::begin(levels_), std::end(levels_), 0);
+    update_gains(state_.apu.time);
+    refresh_levels(state_.apu.time);
+}
+
+/* Save states */
+void APU::save_state(StateWriter& out) const {
+    const ApuState& apu = state_.apu;
+    out.u64(apu.time);
+    for (const ApuState::Channel& channel : apu.channels) {
+        out.u64(channel.next_edge);
+        out.u16(channel.length);
+        out.u8(channel.position);
+        out.u8(channel.volume);
+        out.u8(channel.envelope_timer);
+        out.boolean(channel.enabled);
+    }
+    out.u16(apu.lfsr);
+    out.u16(apu.sweep_frequency);
+    out.u8(apu.sweep_timer);
+    out.boolean(apu.sweep_enabled);
+    out.u8(apu.sequencer_step);
+}
+
+void APU::load_state(StateReader& in) {
+    ApuState& apu = state_.apu;
+    apu.time = in.u64();
+    for (ApuState::Channel& channel : apu.channels) {
+        channel.next_edge = in.u64();
+        channel.length = in.u16();
+        channel.position = in.u8();
+        channel.volume = in.u8();
+        channel.envelope_timer = in.u8();
+        channel.enabled = in.boolean();
+    }
+    apu.lfsr = in.u16();
+    apu.sweep_frequency = in.u16();
+    apu.sweep_timer = in.u8();
+    apu.sweep_enabled = in.boolean();
+    apu.sequencer_step = in.u8() & 7;
+    restart_output();
+}
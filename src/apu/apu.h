@@ -0,0 +1,139 @@
+#ifndef APU_H
+#define APU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "blip_buffer.h"
+#include "io_registers.h"
+#include "machine_state.h"
+#include "mmu.h"
+#include "state.h"
+
+/* Audio processing unit
+ * Two pulse channels (the first with a frequency sweep), the wave channel
+ * and the noise channel, with length counters, envelopes and the 512 Hz
+ * frame sequencer that clocks them.
+ *
+ * Nothing runs per cycle. The APU catches up to the current cycle only
+ * when a sound register or wave RAM is written, NR52 is read, or samples
+ * are drained, and then generates everything since the last catch-up in
+ * one batch, split at frame sequencer steps. Each channel walks its own
+ * waveform steps and hands level changes to a band-limited step
+ * synthesizer (blip_buffer.h), so the cost follows the number of
+ * waveform edges, not the output rate. Waveforms too fast for the output
+ * rate to carry play as their average level.
+ *
+ * With synthesis disabled the APU keeps only what the game can observe:
+ * NR52 channel status, length counters, sweep (which can stop channel 1)
+ * and envelopes. Waveform positions then stand still, so audio state is
+ * only reproducible between machines running in the same mode.
+ *
+ * The channel state lives in the arena (ApuState), the registers in
+ * MachineState::high. Buffered samples are output: copies and loaded
+ * states start with empty buffers.
+ */
+class APU {
+    public:
+        static constexpr double clock_rate = 4194304.0; // T-cycles per second
+        static constexpr unsigned default_sample_rate = 48000;
+
+        APU(MachineState& state, MMU& mmu);
+        APU(const APU&) = delete;
+        APU& operator=(const APU&) = delete;
+
+        // Claims the sound registers and wave RAM
+        void connect();
+
+        // Registers as the boot ROM leaves them, channel 1 finished its chime
+        void skip_boot_rom();
+
+        // Takes over other's settings; the sample buffers start empty
+        void copy_output(const APU& other);
+
+        void set_enabled(bool enabled);
+        bool enabled() const { return enabled_; }
+
+        // Clears buffered samples
+        void set_sample_rate(unsigned rate);
+        unsigned sample_rate() const { return sample_rate_; }
+
+        // Catches up to the current cycle and returns the number of stereo
+        // sample pairs ready to read
+        std::size_t samples_available();
+
+        // Reads up to count stereo pairs, left first, into out (2 * count
+        // values). Samples that were not drained in time are dropped, the
+        // buffers hold a quarter second.
+        std::size_t read_samples(int16_t* out, std::size_t count);
+        uint64_t dropped_samples() const { return left_.dropped(); }
+
+        // Sets the output (sample buffers, synthesizer levels and gains)
+        // aside and puts it back, for callers that roll the arena back and
+        // run the same cycles again; see GameBoy::hold_output()
+        void hold_output();
+        void restore_output();
+
+        // "APU " section: channel and frame sequencer state
+        void save_state(StateWriter& out) const;
+        void load_state(StateReader& in);
+
+    private:
+        static constexpr uint32_t sequencer_period = 8192; // T-cycles per step
+
+        static uint8_t read_register(void* context, uint16_t address);
+        static uint64_t stable_until(void* context, uint16_t address, uint64_t now);
+        static void write_register(void* context, uint16_t address, uint8_t value);
+        void write(uint8_t reg, uint8_t value);
+
+        uint64_t now() const { return state_.cycles * 4; }
+
+        // Generates everything up to now, in batches no longer than a frame
+        // sequencer step
+        void catch_up(uint64_t now);
+        void clock_sequencer();
+        void clock_sweep();
+        uint16_t sweep_target(); // disables channel 1 on overflow
+        void trigger(int channel);
+
+        // Steps one channel's waveform up to end
+        void run_pulse(int channel, uint64_t end);
+        void run_wave(uint64_t end);
+        void run_noise(uint64_t end);
+
+        bool dac_on(int channel) const;
+        uint16_t frequency(int channel) const;
+        uint8_t level(int channel) const;
+
+        // Hands a level change at time t to the synthesizer
+        void set_level(int channel, uint64_t t, uint8_t level);
+        void refresh_levels(uint64_t t);
+        void update_gains(uint64_t t);
+        void restart_output();
+        void set_averaging_limits();
+
+        MachineState& state_;
+        MMU& mmu_;
+
+        bool enabled_ = true;
+        unsigned sample_rate_ = default_sample_rate;
+        uint64_t min_pulse_period_ = 0;  // faster pulse and wave steps are averaged
+        uint64_t min_wave_period_ = 0;
+
+        uint8_t levels_[4] = {};         // last level handed to the synthesizer
+        int32_t left_gain_[4] = {};
+        int32_t right_gain_[4] = {};
+        BlipBuffer left_;
+        BlipBuffer right_;
+
+        struct HeldOutput {
+            BlipBuffer left;
+            BlipBuffer right;
+            uint8_t levels[4];
+            int32_t left_gain[4];
+            int32_t right_gain[4];
+        };
+        std::unique_ptr<HeldOutput> held_; // allocated by the first hold_output()
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef APU_STATE_H
+#define APU_STATE_H
+
+#include <cstdint>
+
+// Channel and frame sequencer state, kept in the machine state arena. The
+// sound registers and wave RAM sit in MachineState::high. Times are in
+// T-cycles (4 per M-cycle), the clock the channel timers count.
+struct ApuState {
+    struct Channel {
+        uint64_t next_edge = 0;      // next step of the waveform
+        uint16_t length = 0;         // length counter, the channel stops at 0
+        uint8_t position = 0;        // duty step (pulse) or sample index (wave)
+        uint8_t volume = 0;          // envelope volume, 0-15
+        uint8_t envelope_timer = 0;
+        bool enabled = false;        // NR52 status bit
+    };
+
+    uint64_t time = 0;               // everything up to here has been generated
+    Channel channels[4];
+    uint16_t lfsr = 0x7FFF;          // noise shift register
+    uint16_t sweep_frequency = 0;    // channel 1 shadow frequency
+    uint8_t sweep_timer = 0;
+    bool sweep_enabled = false;
+    uint8_t sequencer_step = 0;      // frame sequencer, 0-7 at 512 Hz
+};
+
+#endif
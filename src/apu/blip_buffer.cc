@@ -0,0 +1,112 @@
+#include "blip_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int phase_bits = 5;
+constexpr int phases = 1 << phase_bits;
+constexpr int kernel_width = 16;
+constexpr int kernel_bits = 15;    // each phase sums to 1 << kernel_bits
+constexpr double cutoff = 0.9;     // of the output Nyquist frequency
+
+// Windowed-sinc impulse for each sub-sample phase, delayed by
+// kernel_width / 2 - 1 samples so every tap lands at or after the delta
+struct Kernel {
+    int32_t taps[phases][kernel_width];
+
+    Kernel() {
+        const double pi = std::acos(-1.0);
+        for (int phase = 0; phase < phases; phase++) {
+            double weights[kernel_width];
+            double sum = 0;
+            for (int k = 0; k < kernel_width; k++) {
+                double x = k - (kernel_width / 2 - 1) - static_cast<double>(phase) / phases;
+                double sinc = x == 0 ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+                double n = (x + kernel_width / 2) / kernel_width; // Blackman window over the taps
+                double window = 0.42 - 0.5 * std::cos(2 * pi * n) + 0.08 * std::cos(4 * pi * n);
+                weights[k] = sinc * std::max(window, 0.0);
+                sum += weights[k];
+            }
+            // round so each phase sums to exactly 1.0, or steps leave a DC error behind
+            int32_t total = 0;
+            for (int k = 0; k < kernel_width; k++) {
+                taps[phase][k] = static_cast<int32_t>(std::lround(weights[k] / sum * (1 << kernel_bits)));
+                total += taps[phase][k];
+            }
+            taps[phase][kernel_width / 2 - 1] += (1 << kernel_bits) - total;
+        }
+    }
+};
+
+const Kernel& kernel() {
+    static const Kernel table;
+    return table;
+}
+
+}
+
+BlipBuffer::BlipBuffer(double clock_rate, double sample_rate, std::size_t capacity, uint32_t max_frame_clocks):
+    factor_(static_cast<uint64_t>(sample_rate / clock_rate * 4294967296.0)),
+    capacity_(capacity),
+    frame_samples_(static_cast<std::size_t>(max_frame_clocks * sample_rate / clock_rate) + 2)
+{
+    buffer_.assign(capacity + frame_samples_ + kernel_width, 0);
+    kernel();
+}
+
+void BlipBuffer::add_delta(uint32_t clock, int32_t delta) {
+    uint64_t position = offset_ + clock * factor_;
+    std::size_t index = static_cast<std::size_t>(position >> frac_bits);
+    const int32_t* taps = kernel().taps[(position >> (frac_bits - phase_bits)) & (phases - 1)];
+    int64_t* out = buffer_.data() + index;
+    for (int k = 0; k < kernel_width; k++) {
+        out[k] += static_cast<int64_t>(taps[k]) * delta;
+    }
+}
+
+void BlipBuffer::end_frame(uint32_t clocks) {
+    offset_ += clocks * factor_;
+    available_ = static_cast<std::size_t>(offset_ >> frac_bits);
+    if (available_ > capacity_) {
+        std::size_t count = available_ - capacity_ / 2;
+        dropped_ += count;
+        remove_samples(count, nullptr, 0);
+    }
+}
+
+std::size_t BlipBuffer::read_samples(int16_t* out, std::size_t count, std::size_t stride) {
+    count = std::min(count, available_);
+    remove_samples(count, out, stride);
+    return count;
+}
+
+void BlipBuffer::remove_samples(std::size_t count, int16_t* out, std::size_t stride) {
+    int64_t integrator = integrator_;
+    for (std::size_t i = 0; i < count; i++) {
+        integrator += buffer_[i];
+        if (out) {
+            int64_t sample = integrator >> kernel_bits;
+            out[i * stride] = static_cast<int16_t>(std::clamp<int64_t>(sample, INT16_MIN, INT16_MAX));
+        }
+        integrator -= integrator >> bass_shift;
+    }
+    integrator_ = integrator;
+
+    // keep the unread samples and the tails of impulses beyond them
+    std::size_t live = available_ + kernel_width;
+    std::memmove(buffer_.data(), buffer_.data() + count, (live - count) * sizeof(int64_t));
+    std::fill(buffer_.data() + live - count, buffer_.data() + live, 0);
+    offset_ -= static_cast<uint64_t>(count) << frac_bits;
+    available_ -= count;
+}
+
+// Deltas only ever land in the current frame, so nothing past it needs zeroing
+void BlipBuffer::clear() {
+    std::size_t live = std::min(available_ + frame_samples_ + kernel_width, buffer_.size());
+    std::fill(buffer_.data(), buffer_.data() + live, 0);
+    offset_ = 0;
+    available_ = 0;
+    integrator_ = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Band-limited step synthesis
+ * A square-ish source is described by the times its level changes. Each
+ * change adds a windowed-sinc impulse, scaled by the size of the step, to
+ * a buffer at the change's exact sub-sample position; reading sums the
+ * impulses back into levels. The result is the source low-passed just
+ * below the output Nyquist frequency, so it can be resampled to any rate
+ * without aliasing, and the work is per level change, not per clock.
+ *
+ * Time runs in frames: deltas are added at clock offsets from the start
+ * of the current frame, end_frame() makes the samples before its end
+ * readable and starts the next frame there. A frame may be at most
+ * max_frame_clocks long. When unread samples exceed the capacity the
+ * oldest half is dropped, so a machine nobody listens to neither grows
+ * nor moves the whole buffer every frame.
+ */
+class BlipBuffer {
+    public:
+        BlipBuffer(double clock_rate, double sample_rate, std::size_t capacity, uint32_t max_frame_clocks);
+
+        void add_delta(uint32_t clock, int32_t delta);
+        void end_frame(uint32_t clocks);
+
+        std::size_t samples_available() const { return available_; }
+
+        // Reads up to count samples to out[0], out[stride], ...
+        std::size_t read_samples(int16_t* out, std::size_t count, std::size_t stride);
+
+        void clear();
+
+        uint64_t dropped() const { return dropped_; }
+
+    private:
+        static constexpr int frac_bits = 32;
+        static constexpr int bass_shift = 9; // DC blocker, about 15 Hz at 48 kHz
+
+        void remove_samples(std::size_t count, int16_t* out, std::size_t stride);
+
+        uint64_t factor_;      // samples per clock, frac_bits fraction
+        uint64_t offset_ = 0;  // start of the current frame, in samples
+        std::size_t available_ = 0;
+        std::size_t capacity_;
+        std::size_t frame_samples_; // most samples one frame can span
+        int64_t integrator_ = 0;
+        std::vector<int64_t> buffer_;
+        uint64_t dropped_ = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "bank_controller.h"
+
+BankController::BankController(const CartridgeHeader& header, std::size_t rom_banks):
+    mapper_(header.mapper),
+    rom_banks_(rom_banks),
+    ram_banks_(header.ram_size / 0x2000),
+    has_ram_(header.has_ram && header.ram_size > 0),
+    has_rtc_(header.has_rtc)
+{
+    // ROM-only cartridges with RAM have nothing to enable it
+    ram_enabled_ = mapper_ == MapperKind::None;
+}
+
+bool BankController::write_register(uint16_t address, uint8_t value, uint64_t now) {
+    switch (mapper_) {
+        case MapperKind::None:
+            return false;
+
+        case MapperKind::MBC1:
+            switch (address >> 13) {
+                case 0: ram_enabled_ = (value & 0x0F) == 0x0A; break;
+                case 1: rom_bank_ = (value & 0x1F) ? (value & 0x1F) : 1; break;
+                case 2: bank2_ = value & 0x03; break;
+                default: mbc1_mode_ = value & 0x01; break;
+            }
+            return true;
+
+        case MapperKind::MBC2:
+            if (address >= 0x4000) {
+                return false;
+            }
+            // address bit 8 picks the register
+            if (address & 0x0100) {
+                rom_bank_ = (value & 0x0F) ? (value & 0x0F) : 1;
+            } else {
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            }
+            return true;
+
+        case MapperKind::MBC3:
+            switch (address >> 13) {
+                case 0: ram_enabled_ = (value & 0x0F) == 0x0A; break;
+                case 1: rom_bank_ = (value & 0x7F) ? (value & 0x7F) : 1; break;
+                case 2: bank2_ = value & 0x0F; break;
+                default:
+                    // writing 0x00 then 0x01 copies the clock into the readable registers
+                    if (latch_write_ == 0x00 && value == 0x01 && has_rtc_) {
+                        update_rtc(now);
+                        for (int i = 0; i < 5; i++) {
+                            rtc_latched_[i] = rtc_[i];
+                        }
+                    }
+                    latch_write_ = value;
+                    return false;
+            }
+            return true;
+
+        case MapperKind::MBC5:
+            if (address < 0x2000) {
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            } else if (address < 0x3000) {
+                rom_bank_ = (rom_bank_ & 0x100) | value;
+            } else if (address < 0x4000) {
+                rom_bank_ = (rom_bank_ & 0xFF) | ((value & 0x01) << 8);
+            } else if (address < 0x6000) {
+                bank2_ = value & 0x0F;
+            } else {
+                return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+std::size_t BankController::low_rom_bank() const {
+    if (mapper_ == MapperKind::MBC1 && mbc1_mode_) {
+        return (bank2_ << 5) % rom_banks_;
+    }
+    return 0;
+}
+
+std::size_t BankController::high_rom_bank() const {
+    std::size_t bank = rom_bank_;
+    if (mapper_ == MapperKind::MBC1) {
+        bank |= bank2_ << 5;
+    }
+    return bank % rom_banks_;
+}
+
+BankController::RamMapping BankController::ram_mapping() const {
+    if (!ram_enabled_) {
+        return RamMapping::None;
+    }
+    if (mapper_ == MapperKind::MBC2) {
+        return RamMapping::MBC2Ram;
+    }
+    if (mapper_ == MapperKind::MBC3 && bank2_ >= 0x08) {
+        return has_rtc_ && bank2_ <= 0x0C ? RamMapping::Rtc : RamMapping::None;
+    }
+    return has_ram_ ? RamMapping::Ram : RamMapping::None;
+}
+
+std::size_t BankController::ram_bank() const {
+    if (ram_banks_ <= 1) {
+        return 0;
+    }
+    if (mapper_ == MapperKind::MBC1) {
+        return mbc1_mode_ ? bank2_ % ram_banks_ : 0;
+    }
+    return bank2_ % ram_banks_;
+}
+
+uint8_t BankController::read_rtc() const {
+    return rtc_latched_[bank2_ - 0x08];
+}
+
+void BankController::write_rtc(uint8_t value, uint64_t now) {
+    static constexpr uint8_t masks[5] = { 0x3F, 0x3F, 0x1F, 0xFF, 0xC1 };
+    update_rtc(now);
+    int reg = bank2_ - 0x08;
+    rtc_[reg] = value & masks[reg];
+    if (reg == 0) {
+        rtc_updated_ = now; // writing seconds restarts the current second
+    }
+}
+
+void BankController::update_rtc(uint64_t now) {
+    if (rtc_[4] & 0x40) {
+        rtc_updated_ = now; // halted
+        return;
+    }
+    uint64_t seconds = (now - rtc_updated_) / cycles_per_second;
+    if (seconds == 0) {
+        return;
+    }
+    rtc_updated_ += seconds * cycles_per_second;
+
+    uint64_t sec = rtc_[0] + seconds;
+    uint64_t min = rtc_[1] + sec / 60;
+    uint64_t hour = rtc_[2] + min / 60;
+    uint64_t day = ((rtc_[4] & 0x01) << 8 | rtc_[3]) + hour / 24;
+    rtc_[0] = sec % 60;
+    rtc_[1] = min % 60;
+    rtc_[2] = hour % 24;
+    if (day > 0x1FF) {
+        rtc_[4] |= 0x80; // day counter overflowed
+    }
+    rtc_[3] = day & 0xFF;
+    rtc_[4] = (rtc_[4] & 0xC0) | ((day >> 8) & 0x01);
+}
+
+void BankController::save_state(StateWriter& out) const {
+    out.boolean(ram_enabled_);
+    out.u16(rom_bank_);
+    out.u8(bank2_);
+    out.boolean(mbc1_mode_);
+    out.bytes(rtc_, sizeof(rtc_));
+    out.bytes(rtc_latched_, sizeof(rtc_latched_));
+    out.u64(rtc_updated_);
+    out.u8(latch_write_);
+}
+
+void BankController::load_state(StateReader& in) {
+    ram_enabled_ = in.boolean();
+    rom_bank_ = in.u16();
+    bank2_ = in.u8();
+    mbc1_mode_ = in.boolean();
+    in.bytes(rtc_, sizeof(rtc_));
+    in.bytes(rtc_latched_, sizeof(rtc_latched_));
+    rtc_updated_ = in.u64();
+    latch_write_ = in.u8();
+}
@@ -0,0 +1,77 @@
+#ifndef BANK_CONTROLLER_H
+#define BANK_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "cartridge.h"
+#include "state.h"
+
+struct BankSwitchStats {
+    uint64_t select_writes = 0; // writes to 0x0000-0x7FFF
+    uint64_t rom_switches = 0;  // writes that changed a mapped ROM bank
+    uint64_t ram_switches = 0;  // writes that changed what 0xA000-0xBFFF shows
+};
+
+/* Memory bank controller
+ * Register state of the cartridge's MBC (none, MBC1, MBC2, MBC3 with RTC
+ * or MBC5). It only decides which banks are mapped; the MMU turns that into
+ * page pointers after every register write, so reads never do bank
+ * arithmetic. Plain data, so it copies and saves with the MMU.
+ *
+ * The MBC3 clock runs on emulated time (1 048 576 M-cycles per second),
+ * which keeps runs reproducible.
+ */
+class BankController {
+    public:
+        // What 0xA000-0xBFFF shows
+        enum class RamMapping : uint8_t {
+            None,    // disabled or absent, reads 0xFF
+            Ram,     // ram_bank() of the cartridge RAM
+            MBC2Ram, // 512 half-bytes, repeated over the whole area
+            Rtc      // the latched MBC3 clock register rtc_register()
+        };
+
+        BankController() = default;
+        BankController(const CartridgeHeader& header, std::size_t rom_banks);
+
+        // Handles a write to 0x0000-0x7FFF, returns true if the mapping changed
+        bool write_register(uint16_t address, uint8_t value, uint64_t now);
+
+        std::size_t low_rom_bank() const;  // mapped at 0x0000-0x3FFF
+        std::size_t high_rom_bank() const; // mapped at 0x4000-0x7FFF
+        RamMapping ram_mapping() const;
+        std::size_t ram_bank() const;
+
+        uint8_t read_rtc() const; // latched value of the selected register
+        void write_rtc(uint8_t value, uint64_t now);
+
+        // Register and clock state; the mapper itself comes from the cartridge
+        void save_state(StateWriter& out) const;
+        void load_state(StateReader& in);
+
+    private:
+        static constexpr uint64_t cycles_per_second = 1 << 20;
+
+        // Advances the live clock registers to now
+        void update_rtc(uint64_t now);
+
+        MapperKind mapper_ = MapperKind::None;
+        std::size_t rom_banks_ = 2;
+        std::size_t ram_banks_ = 0;
+        bool has_ram_ = false;
+        bool has_rtc_ = false;
+
+        bool ram_enabled_ = false;
+        uint16_t rom_bank_ = 1;  // MBC1: low 5 bits, MBC2: 4 bits, MBC3: 7 bits, MBC5: 9 bits
+        uint8_t bank2_ = 0;      // MBC1 upper bits / RAM bank, MBC3/MBC5 RAM bank or RTC select
+        bool mbc1_mode_ = false; // MBC1 advanced banking
+
+        /* MBC3 clock */
+        // seconds, minutes, hours, day low, day high (bit 0 day 8, bit 6 halt, bit 7 carry)
+        uint8_t rtc_[5] = {};
+        uint8_t rtc_latched_[5] = {};
+        uint64_t rtc_updated_ = 0; // cycle the live registers were last advanced to
+        uint8_t latch_write_ = 0xFF;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "cartridge.h"
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint8_t nintendo_logo[48] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E
+};
+
+constexpr std::size_t header_end = 0x150;
+
+// Fills mapper and feature flags from the type byte, false if unsupported
+bool describe_type(CartridgeHeader& header) {
+    bool ram = false, battery = false, rtc = false;
+    MapperKind mapper = MapperKind::None;
+    switch (header.type) {
+        case 0x00: break;
+        case 0x01: mapper = MapperKind::MBC1; break;
+        case 0x02: mapper = MapperKind::MBC1; ram = true; break;
+        case 0x03: mapper = MapperKind::MBC1; ram = battery = true; break;
+        case 0x05: mapper = MapperKind::MBC2; ram = true; break;
+        case 0x06: mapper = MapperKind::MBC2; ram = battery = true; break;
+        case 0x08: ram = true; break;
+        case 0x09: ram = battery = true; break;
+        case 0x0F: mapper = MapperKind::MBC3; rtc = battery = true; break;
+        case 0x10: mapper = MapperKind::MBC3; rtc = ram = battery = true; break;
+        case 0x11: mapper = MapperKind::MBC3; break;
+        case 0x12: mapper = MapperKind::MBC3; ram = true; break;
+        case 0x13: mapper = MapperKind::MBC3; ram = battery = true; break;
+        case 0x19: case 0x1C: mapper = MapperKind::MBC5; break; // 0x1C-0x1E add rumble
+        case 0x1A: case 0x1D: mapper = MapperKind::MBC5; ram = true; break;
+        case 0x1B: case 0x1E: mapper = MapperKind::MBC5; ram = battery = true; break;
+        default: return false;
+    }
+    header.mapper = mapper;
+    header.has_ram = ram;
+    header.has_battery = battery;
+    header.has_rtc = rtc;
+    return true;
+}
+
+}
+
+CartridgeHeader Cartridge::parse_header(const uint8_t* rom, std::size_t size) {
+    if (size < header_end) {
+        throw CartridgeError("ROM is smaller than its header");
+    }
+    if (std::memcmp(rom + 0x104, nintendo_logo, sizeof(nintendo_logo)) != 0) {
+        throw CartridgeError("header logo does not match");
+    }
+
+    uint8_t checksum = 0;
+    for (std::size_t addr = 0x134; addr <= 0x14C; addr++) {
+        checksum = checksum - rom[addr] - 1;
+    }
+    if (checksum != rom[0x14D]) {
+        throw CartridgeError("header checksum does not match");
+    }
+
+    CartridgeHeader header;
+    header.header_checksum = rom[0x14D];
+    header.global_checksum = (rom[0x14E] << 8) | rom[0x14F];
+    for (std::size_t addr = 0x134; addr < 0x144 && rom[addr] != 0; addr++) {
+        header.title += static_cast<char>(rom[addr]);
+    }
+
+    header.type = rom[0x147];
+    if (!describe_type(header)) {
+        throw CartridgeError("unsupported cartridge type " + std::to_string(header.type));
+    }
+
+    uint8_t rom_code = rom[0x148];
+    if (rom_code > 0x08) {
+        throw CartridgeError("invalid ROM size code " + std::to_string(rom_code));
+    }
+    header.rom_size = std::size_t(0x8000) << rom_code;
+    if (size < header.rom_size) {
+        throw CartridgeError("ROM file is shorter than the header's ROM size");
+    }
+
+    static constexpr std::size_t ram_sizes[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+    uint8_t ram_code = rom[0x149];
+    if (ram_code >= sizeof(ram_sizes) / sizeof(ram_sizes[0])) {
+        throw CartridgeError("invalid RAM size code " + std::to_string(ram_code));
+    }
+    header.ram_size = ram_sizes[ram_code];
+    if (header.mapper == MapperKind::MBC2) {
+        header.ram_size = 512; // built in, 4 bits per byte
+    }
+    return header;
+}
+
+std::shared_ptr<const Cartridge> Cartridge::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw CartridgeError("cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        throw CartridgeError("cannot read the size of " + path);
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (mem == MAP_FAILED) {
+        throw CartridgeError("cannot map " + path + ": " + std::strerror(errno));
+    }
+
+    const uint8_t* rom = static_cast<const uint8_t*>(mem);
+    try {
+        return std::shared_ptr<const Cartridge>(new Cartridge(rom, size, parse_header(rom, size)));
+    } catch (...) {
+        munmap(mem, size);
+        throw;
+    }
+}
+
+Cartridge::Cartridge(const uint8_t* rom, std::size_t mapped_size, CartridgeHeader header):
+    rom_(rom),
+    mapped_size_(mapped_size),
+    header_(std::move(header))
+{
+}
+
+Cartridge::~Cartridge() {
+    munmap(const_cast<uint8_t*>(rom_), mapped_size_);
+}
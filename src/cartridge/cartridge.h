@@ -0,0 +1,76 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+class CartridgeError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+};
+
+// Bank controller named by the cartridge type byte (0x147)
+enum class MapperKind : uint8_t {
+    None,
+    MBC1,
+    MBC2,
+    MBC3,
+    MBC5
+};
+
+struct CartridgeHeader {
+    std::string title;
+    uint8_t type = 0;
+    MapperKind mapper = MapperKind::None;
+    bool has_ram = false;
+    bool has_battery = false;
+    bool has_rtc = false;
+    std::size_t rom_size = 0; // bytes, from 0x148
+    std::size_t ram_size = 0; // bytes, from 0x149; MBC2's built-in RAM counts as 512
+    uint8_t header_checksum = 0;  // 0x14D
+    uint16_t global_checksum = 0; // 0x14E-0x14F, big-endian in the ROM
+};
+
+/* Cartridge ROM
+ * The ROM file is mmap'd read-only and never copied: the MMU points its
+ * ROM pages straight into the mapping, and every machine that loads the
+ * same Cartridge shares it. Loading only reads the header page, so it costs
+ * an open, an fstat and an mmap regardless of ROM size.
+ *
+ * load() throws CartridgeError when the file cannot be mapped or the header
+ * fails validation (logo, header checksum, cartridge type, ROM/RAM size
+ * codes, file shorter than the declared ROM size).
+ */
+class Cartridge {
+    public:
+        static constexpr std::size_t rom_bank_size = 0x4000;
+
+        static std::shared_ptr<const Cartridge> load(const std::string& path);
+
+        // Validates header and returns it parsed, throws CartridgeError
+        static CartridgeHeader parse_header(const uint8_t* rom, std::size_t size);
+
+        ~Cartridge();
+        Cartridge(const Cartridge&) = delete;
+        Cartridge& operator=(const Cartridge&) = delete;
+
+        const CartridgeHeader& header() const { return header_; }
+
+        const uint8_t* rom() const { return rom_; }
+        std::size_t rom_banks() const { return header_.rom_size / rom_bank_size; }
+
+        // Start of 16 KiB bank, wrapping like the address lines do
+        const uint8_t* rom_bank(std::size_t bank) const { return rom_ + (bank % rom_banks()) * rom_bank_size; }
+
+    private:
+        Cartridge(const uint8_t* rom, std::size_t mapped_size, CartridgeHeader header);
+
+        const uint8_t* rom_;
+        std::size_t mapped_size_;
+        CartridgeHeader header_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+class CPU;
+
+// One pre-decoded instruction: the handler to call, its immediate operand
+// and its length so PC can be advanced without touching memory
+struct MicroOp {
+    void (CPU::*handler)();
+    uint16_t operand;
+    uint8_t length;
+    uint8_t opcode;
+};
+
+struct BlockCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;        // blocks decoded because nothing was cached for the PC
+    uint64_t invalidations = 0; // blocks re-decoded because their page was written
+};
+
+/* Decoded block cache
+ * A block is a straight-line run of instructions starting at some PC, decoded
+ * once into MicroOps and replayed on later visits. Blocks end after the first
+ * control-flow instruction, after max_block_ops, or before an instruction that
+ * would cross the 256-byte page the block starts on, so a block only ever
+ * depends on one page and MMU::page_generation of that page tells whether it
+ * is still valid.
+ *
+ * Lookups are direct-mapped on (ROM bank, PC); a colliding block simply
+ * replaces the old one. Storage is only allocated once the cache is enabled.
+ */
+class BlockCache {
+    public:
+        static constexpr int max_block_ops = 16;
+        static constexpr int entries = 1024;
+        static constexpr uint32_t empty_key = 0xFFFFFFFF;
+
+        struct Block {
+            uint32_t key = empty_key;
+            uint32_t generation = 0;
+            uint8_t op_count = 0;
+            uint32_t heat = 0;       // replays since decoding, see Jit::hot_threshold
+            void* native = nullptr;  // Jit translation, if any
+            bool polls = false;      // a possible idle loop, see polling_loop()
+            MicroOp ops[max_block_ops];
+        };
+
+        void enable() {
+            if (blocks_.empty()) {
+                blocks_.resize(entries);
+            }
+        }
+
+        void clear() {
+            for (Block& block : blocks_) {
+                block.key = empty_key;
+            }
+        }
+
+        // Forgets every native translation, the decoded ops stay
+        void drop_native() {
+            for (Block& block : blocks_) {
+                block.native = nullptr;
+                block.heat = 0;
+            }
+        }
+
+        // The bank is only part of the key for code in the switchable ROM area
+        static uint32_t key(uint16_t pc, uint16_t rom_bank) {
+            uint32_t bank = (pc >= 0x4000 && pc < 0x8000) ? rom_bank : 0;
+            return (bank << 16) | pc;
+        }
+
+        Block& slot(uint32_t key) {
+            return blocks_[(key ^ (key >> 16) * 0x9E5) & (entries - 1)];
+        }
+
+        // Code outside ROM, WRAM and HRAM is always interpreted
+        static bool cacheable(uint16_t pc) {
+            return pc < 0x8000 || (pc >= 0xC000 && pc < 0xE000) || (pc >= 0xFF80 && pc < 0xFFFF);
+        }
+
+        // Instructions that may leave straight-line flow or change how the
+        // CPU runs end a block
+        static bool ends_block(uint8_t opcode) {
+            switch (opcode) {
+                case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+                case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+                case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+                case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET, RETI
+                case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+                case 0x10: case 0x76: case 0xF3: case 0xFB: // STOP, HALT, DI, EI
+                case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB:
+                case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD: // illegal
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // Only reads memory and changes registers: no writes, stack, I/O
+        // side effects or changes to how the CPU runs
+        static bool side_effect_free(const MicroOp& op) {
+            if (op.opcode == 0xCB) {
+                // BIT b,(HL) reads; the other (HL) forms write back
+                return (op.operand & 0x07) != 0x06 || (op.operand >= 0x40 && op.operand < 0x80);
+            }
+            switch (op.opcode) {
+                case 0x02: case 0x12: case 0x22: case 0x32: case 0x08: case 0x34: case 0x35: case 0x36:
+                case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77:
+                case 0xE0: case 0xE2: case 0xEA: // stores
+                case 0xC1: case 0xD1: case 0xE1: case 0xF1: case 0xC5: case 0xD5: case 0xE5: case 0xF5: // POP, PUSH
+                case 0x10: case 0x76: case 0xF3: case 0xFB: // STOP, HALT, DI, EI
+                    return false;
+                default:
+                    // every other block-ending opcode is a call, return, RST,
+                    // JP (HL) or illegal; a polling loop only ends in a jump
+                    return !ends_block(op.opcode) || is_jump(op.opcode);
+            }
+        }
+
+        // A block that only reads and jumps back to its own start at pc. Run
+        // twice with the same registers it does the same thing forever, until
+        // memory it reads changes; see CPU::run_blocks.
+        static bool polling_loop(const Block& block, uint16_t pc) {
+            if (block.op_count == 0) {
+                return false;
+            }
+            uint16_t end = pc;
+            for (uint8_t i = 0; i < block.op_count; i++) {
+                if (!side_effect_free(block.ops[i])) {
+                    return false;
+                }
+                end += block.ops[i].length;
+            }
+            const MicroOp& last = block.ops[block.op_count - 1];
+            switch (last.opcode) {
+                case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+                    return static_cast<uint16_t>(end + static_cast<int8_t>(last.operand)) == pc;
+                case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: // JP
+                    return last.operand == pc;
+                default:
+                    return false;
+            }
+        }
+
+        BlockCacheStats stats;
+
+    private:
+        static bool is_jump(uint8_t opcode) {
+            switch (opcode) {
+                case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+                case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        std::vector<Block> blocks_;
+};
+
+#endif
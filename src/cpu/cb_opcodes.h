@@ -0,0 +1,146 @@
+#ifndef CB_OPCODES_H
+#define CB_OPCODES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "cpu.h"
+
+/* CB prefix family
+ * Every CB opcode is one instantiation of CPU::opcode_cb_family, with the
+ * operation, bit index and operand decoded from the opcode at compile time:
+ *   bits 7-6: 0 = rotate/shift (kind in bits 5-3), 1 = BIT, 2 = RES, 3 = SET
+ *   bits 5-3: bit index for BIT/RES/SET
+ *   bits 2-0: B, C, D, E, H, L, (HL), A
+ * Included by the files that instantiate the family or use the shift helpers
+ * so everything below inlines into the handlers.
+ */
+
+/* Rotate / shift helpers */
+inline uint8_t CPU::_opcode_rlc(uint8_t val) {
+    uint8_t carry_flag = (val >> 7) & 0x1;
+    uint8_t res = val << 1 | carry_flag;
+    regs().F.set_shift(res, carry_flag);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_rrc(uint8_t val) {
+    uint8_t carry_flag = val & 0x01;
+    uint8_t res = val >> 1 | (carry_flag << 7);
+    regs().F.set_shift(res, carry_flag);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_rl(uint8_t val) {
+    uint8_t old_carry_bit = regs().F.get_carry_flag();
+    uint8_t new_carry_bit = (val >> 7) & 0x1;
+    uint8_t res = (val << 1) | old_carry_bit;
+    regs().F.set_shift(res, new_carry_bit);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_rr(uint8_t val) {
+    uint8_t old_carry_bit = regs().F.get_carry_flag();
+    uint8_t new_carry_bit = val & 0x01;
+    uint8_t res = (val >> 1) | (old_carry_bit << 7);
+    regs().F.set_shift(res, new_carry_bit);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_sla(uint8_t val) {
+    uint8_t carry_flag = (val >> 7) & 0x1;
+    uint8_t res = val << 1;
+    regs().F.set_shift(res, carry_flag);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_sra(uint8_t val) {
+    // arithmetic shift, bit 7 is kept
+    uint8_t carry_flag = val & 0x01;
+    uint8_t res = (val >> 1) | (val & 0x80);
+    regs().F.set_shift(res, carry_flag);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_swap(uint8_t val) {
+    uint8_t res = ((val & 0xF0) >> 4) | ((val & 0x0F) << 4);
+    regs().F.set_shift(res, false);
+    return res;
+}
+
+inline uint8_t CPU::_opcode_srl(uint8_t val) {
+    uint8_t lsb = val & 0x01;
+    uint8_t res = val >> 1;
+    regs().F.set_shift(res, lsb);
+    return res;
+}
+
+/* Family handler */
+template <CPU::CBOperation operation, uint8_t bit, uint8_t operand>
+void CPU::opcode_cb_family() {
+    constexpr Reg8 operand_regs[8] = {B_, C_, D_, E_, H_, L_, A_ /* unused, (HL) */, A_};
+    constexpr bool uses_hl = operand == 6;
+    constexpr Reg8 reg = operand_regs[operand];
+
+    uint8_t val;
+    if constexpr (uses_hl) {
+        val = gameboy.mmu.read(indirect(HL_));
+    } else {
+        val = regs().get(reg);
+    }
+
+    uint8_t res;
+    if constexpr (operation == CBOperation::BIT) {
+        // BIT leaves C alone and never writes back
+        regs().F.set_zero_flag(((val >> bit) & 0x1) == 0);
+        regs().F.set_subtract_flag(false);
+        regs().F.set_half_carry_flag(true);
+        return;
+    } else if constexpr (operation == CBOperation::RES) {
+        res = val & ~(1 << bit);
+    } else if constexpr (operation == CBOperation::SET) {
+        res = val | (1 << bit);
+    } else if constexpr (operation == CBOperation::RLC) {
+        res = _opcode_rlc(val);
+    } else if constexpr (operation == CBOperation::RRC) {
+        res = _opcode_rrc(val);
+    } else if constexpr (operation == CBOperation::RL) {
+        res = _opcode_rl(val);
+    } else if constexpr (operation == CBOperation::RR) {
+        res = _opcode_rr(val);
+    } else if constexpr (operation == CBOperation::SLA) {
+        res = _opcode_sla(val);
+    } else if constexpr (operation == CBOperation::SRA) {
+        res = _opcode_sra(val);
+    } else if constexpr (operation == CBOperation::SWAP) {
+        res = _opcode_swap(val);
+    } else {
+        res = _opcode_srl(val);
+    }
+
+    if constexpr (uses_hl) {
+        gameboy.mmu.write(indirect(HL_), res);
+    } else {
+        regs().set(reg, res);
+    }
+}
+
+/* Dispatch table */
+template <uint8_t opcode>
+constexpr CPU::Handler CPU::cb_handler() {
+    constexpr uint8_t group = opcode >> 6;
+    constexpr uint8_t y = (opcode >> 3) & 0x7;
+    constexpr uint8_t z = opcode & 0x7;
+    constexpr CBOperation operation = group == 0
+        ? static_cast<CBOperation>(y)
+        : static_cast<CBOperation>(static_cast<uint8_t>(CBOperation::BIT) + group - 1);
+    return &CPU::opcode_cb_family<operation, group == 0 ? 0 : y, z>;
+}
+
+template <std::size_t... opcodes>
+constexpr std::array<CPU::Handler, 256> CPU::make_cb_handlers(std::index_sequence<opcodes...>) {
+    return {{cb_handler<static_cast<uint8_t>(opcodes)>()...}};
+}
+
+#endif
@@ -1,22 +1,163 @@
 #include "cpu.h"
+#include <algorithm>
+#include <cstring>
 
 CPU::CPU(GameBoy& gameboy): 
     gameboy(gameboy),
-    AF_(A_, F_),
-    BC_(B_, C_),
-    DE_(D_ ,E_),
-    HL_(H_, L_)
+    machine_()
 {
 }
 
-void CPU::tick() {
-    execute_opcode();
+void CPU::skip_boot_rom() {
+    regs().set(AF_, 0x01B0);
+    regs().set(BC_, 0x0013);
+    regs().set(DE_, 0x00D8);
+    regs().set(HL_, 0x014D);
+    regs().set(SP_, 0xFFFE);
+    regs().set(PC_, 0x0100);
+    machine_.cpu.ime = false;
+    machine_.cpu.ime_pending = false;
+    machine_.cpu.halted = false;
+    machine_.cpu.stopped = false;
+    machine_.cpu.locked = false;
+    machine_.cpu.yield = false;
+    machine_.high[io::IF] = 0xE1;
+    machine_.high[io::IE] = 0x00;
+    idle_block_ = nullptr;
+    idle_stats_ = IdleStats();
+}
+
+// Every interrupt request or enable change has to reach run_until()
+void CPU::connect() {
+    gameboy.mmu.map_io(0xFF00 | io::IF, nullptr, write_register, this);
+    gameboy.mmu.map_io(0xFF00 | io::IE, nullptr, write_register, this);
+}
+
+void CPU::write_register(void* context, uint16_t address, uint8_t value) {
+    CPU& cpu = *static_cast<CPU*>(context);
+    // IF bits 5-7 do not exist and read as 1
+    cpu.machine_.high[address & 0xFF] = (address & 0xFF) == io::IF ? 0xE0 | value : value;
+    cpu.machine_.cpu.yield = true;
+}
+
+void CPU::save_state(StateWriter& out) const {
+    for (Reg16 reg : {AF_, BC_, DE_, HL_, SP_, PC_}) {
+        out.u16(regs().get(reg));
+    }
+    out.boolean(machine_.cpu.ime);
+    out.boolean(machine_.cpu.ime_pending);
+    out.boolean(machine_.cpu.halted);
+    out.boolean(machine_.cpu.locked);
+    out.u64(machine_.cpu.retired);
+    out.boolean(machine_.cpu.stopped);
+}
+
+void CPU::load_state(StateReader& in) {
+    for (Reg16 reg : {AF_, BC_, DE_, HL_, SP_, PC_}) {
+        regs().set(reg, in.u16());
+    }
+    machine_.cpu.ime = in.boolean();
+    machine_.cpu.ime_pending = in.boolean();
+    machine_.cpu.halted = in.boolean();
+    machine_.cpu.locked = in.boolean();
+    machine_.cpu.retired = in.u64();
+    machine_.cpu.stopped = in.remaining() ? in.boolean() : false; // added after version 1
+    // let run_until() look at the loaded IE, IF and halt state
+    machine_.cpu.yield = true;
+}
+
+void CPU::copy_state(const CPU& other) {
+    operand_ = other.operand_;
+    branch_taken_ = other.branch_taken_;
+
+    // block generations match the copied MMU's, so the decoded blocks stay valid
+    block_cache_enabled = other.block_cache_enabled;
+    block_cache_ = other.block_cache_;
+    idle_skip_enabled_ = other.idle_skip_enabled_;
+    idle_block_ = nullptr;
+#ifdef GB_JIT
+    jit_differential = other.jit_differential;
+    set_jit_enabled(other.jit_ != nullptr);
+    if (jit_) {
+        jit_->flush(block_cache_);
+    } else {
+        block_cache_.drop_native();
+    }
+#endif
+}
+
+uint8_t CPU::tick() {
+    uint8_t cycles = machine_.cpu.yield ? service_interrupts() : 0;
+    if (cycles == 0) {
+        if (machine_.cpu.halted || machine_.cpu.locked) {
+            machine_.cycles++;
+            cycles = 1;
+        } else {
+            cycles = execute_opcode();
+            machine_.cpu.retired++;
+        }
+    }
+    if (machine_.cycles >= gameboy.scheduler.next_deadline()) {
+        run_events();
+    }
+    return cycles;
+}
+
+/* Interrupts */
+void CPU::run_events() {
+    gameboy.scheduler.run_due(machine_.cycles);
+    if (pending_interrupts()) {
+        machine_.cpu.yield = true; // an event raised a request
+    }
+}
+
+// Deals with whatever made the CPU yield: finishes an EI, wakes the CPU
+// from HALT or STOP and dispatches the highest priority request. Leaves
+// yield set while the CPU stays halted or locked. Returns the M-cycles
+// spent.
+uint8_t CPU::service_interrupts() {
+    CpuState& cpu = machine_.cpu;
+    cpu.yield = false;
+    if (cpu.locked) {
+        cpu.yield = true;
+        return 0;
+    }
+    uint8_t cycles = 0;
+    if (cpu.ime_pending && !cpu.halted) {
+        cycles = execute_opcode();
+        cpu.retired++;
+        // a DI right after clears ime_pending again
+        cpu.ime = cpu.ime || cpu.ime_pending;
+        cpu.ime_pending = false;
+    }
+
+    uint8_t pending = pending_interrupts();
+    if (cpu.stopped) {
+        pending &= interrupt::joypad;
+    }
+    if (!pending) {
+        cpu.yield = cpu.halted || cpu.locked;
+        return cycles;
+    }
+    cpu.halted = false;
+    cpu.stopped = false;
+    if (!cpu.ime) {
+        return cycles; // HALT ends, but nothing is dispatched
+    }
+
+    uint8_t bit = pending & -pending; // lowest bit has priority
+    machine_.high[io::IF] &= ~bit;
+    cpu.ime = false;
+    stack_push(PC_);
+    regs().set(PC_, 0x40 + 8 * __builtin_ctz(bit));
+    machine_.cycles += interrupt_dispatch_cycles;
+    return cycles + interrupt_dispatch_cycles;
 }
 
 
 uint8_t CPU::get_next_byte() {
-    uint8_t next_byte = gameboy.mmu.read(Address(PC_));
-    PC_.increment();
+    uint8_t next_byte = gameboy.mmu.read(indirect(PC_));
+    regs().increment(PC_);
     return next_byte;
 }
 
@@ -27,39 +168,319 @@ uint16_t CPU::get_next_word() {
     return res;
 }
 
-void CPU::stack_push(const WordRegister& reg) {
-    SP_.decrement();
-    gameboy.mmu.write(Address(SP_), reg.high_byte());
-    SP_.decrement();
-    gameboy.mmu.write(Address(SP_), reg.low_byte());
+// Reads the opcode at PC and its immediate operand (length from opcode_table)
+// into operand_, leaving PC on the next instruction
+uint8_t CPU::fetch() {
+    uint8_t opcode = get_next_byte();
+    switch (opcode_table[opcode].length) {
+        case 2: operand_ = get_next_byte(); break;
+        case 3: operand_ = get_next_word(); break;
+        default: break;
+    }
+    return opcode;
 }
 
-void CPU::stack_pop(WordRegister& reg) {
-    uint8_t lsb = gameboy.mmu.read(Address(SP_));
-    SP_.increment();
-    uint8_t msb = gameboy.mmu.read(Address(SP_));
-    SP_.increment();
-    uint16_t res = msb << 8 + lsb;
-    reg.set_val(res);
+void CPU::stack_push(Reg16 reg) {
+    uint16_t val = regs().get(reg);
+    regs().decrement(SP_);
+    gameboy.mmu.write(indirect(SP_), val >> 8);
+    regs().decrement(SP_);
+    gameboy.mmu.write(indirect(SP_), val & 0xFF);
+}
+
+void CPU::stack_pop(Reg16 reg) {
+    uint8_t lsb = gameboy.mmu.read(indirect(SP_));
+    regs().increment(SP_);
+    uint8_t msb = gameboy.mmu.read(indirect(SP_));
+    regs().increment(SP_);
+    uint16_t res = (msb << 8) | lsb;
+    regs().set(reg, res);
 }
 
 
 bool CPU::check_condition(Condition condition) {
     switch (condition) {
-        case Condition::Z: return F_.get_zero_flag() == 1;
-        case Condition::NZ: return F_.get_zero_flag() == 0;
-        case Condition::C: return F_.get_carry_flag() == 1;
-        case Condition::NC: return F_.get_carry_flag() == 0;
+        case Condition::Z: return regs().F.get_zero_flag() == 1;
+        case Condition::NZ: return regs().F.get_zero_flag() == 0;
+        case Condition::C: return regs().F.get_carry_flag() == 1;
+        case Condition::NC: return regs().F.get_carry_flag() == 0;
         default: return false;
     }
 }
 
-void CPU::execute_opcode() {
-    uint8_t opcode = get_next_byte();
-    if (opcode != 0xCB) {
-        uint8_t cb_opcode = get_next_byte();
-        execute_CB_opcode(cb_opcode);
-    } else {
-        execute_non_CB_opcode(opcode);
+uint8_t CPU::execute_opcode() {
+    // 0xCB dispatches into cb_handlers_ itself, see opcode_cb()
+    uint8_t opcode = fetch();
+    (this->*non_cb_handlers_[opcode])();
+    return account_cycles(opcode);
+}
+
+uint64_t CPU::run(uint64_t max_instructions) {
+    if (block_cache_enabled) {
+        return run_blocks(max_instructions);
     }
-}
\ No newline at end of file
+    return run_interpreter(max_instructions);
+}
+
+uint64_t CPU::run_until(uint64_t target) {
+    uint64_t start = machine_.cycles;
+    Scheduler& scheduler = gameboy.scheduler;
+    while (machine_.cycles < target) {
+        uint64_t stop = std::min(target, scheduler.next_deadline());
+        while (machine_.cycles < stop) {
+            if (machine_.cpu.yield) {
+                service_interrupts();
+                if (machine_.cpu.yield) {
+                    // halted: skip straight to the next event, which may wake the CPU
+                    machine_.cycles = stop;
+                    break;
+                }
+                continue; // an EI'd instruction or a dispatch may have reached stop
+            }
+            // at most max_instruction_cycles each, so this budget cannot pass stop
+            uint64_t budget = (stop - machine_.cycles) / max_instruction_cycles;
+            machine_.cpu.retired += run(budget ? budget : 1);
+            if (idle_block_) {
+                skip_idle(stop);
+            }
+        }
+        run_events();
+    }
+    return machine_.cycles - start;
+}
+
+/* Block cache */
+void CPU::set_block_cache_enabled(bool enabled) {
+    if (enabled) {
+        block_cache_.enable();
+    }
+    block_cache_enabled = enabled;
+}
+
+uint64_t CPU::run_blocks(uint64_t max_instructions) {
+    uint64_t executed = 0;
+    idle_block_ = nullptr;
+    while (executed < max_instructions && !machine_.cpu.yield) {
+        uint16_t pc = regs().get(PC_);
+        if (!BlockCache::cacheable(pc)) {
+            execute_opcode();
+            executed++;
+            continue;
+        }
+
+        uint32_t key = BlockCache::key(pc, gameboy.mmu.rom_bank());
+        BlockCache::Block& block = block_cache_.slot(key);
+        if (block.key != key) {
+            block_cache_.stats.misses++;
+            compile_block(block, key, pc);
+        } else if (block.generation != gameboy.mmu.page_generation(pc)) {
+            block_cache_.stats.invalidations++;
+            compile_block(block, key, pc);
+        } else {
+            block_cache_.stats.hits++;
+        }
+
+        if (block.op_count == 0) {
+            // first instruction straddles the page boundary
+            execute_opcode();
+            executed++;
+            continue;
+        }
+
+        // polling blocks stay interpreted so every pass can be checked
+        bool polls = block.polls && idle_skip_enabled_;
+#ifdef GB_JIT
+        if (jit_ && !polls && !block.native && ++block.heat >= Jit::hot_threshold) {
+            block.native = jit_->translate(*this, block, pc);
+        }
+        if (block.native && max_instructions - executed >= block.op_count) {
+            uint64_t ran = run_native(block.native, max_instructions - executed);
+            if (ran) {
+                executed += ran;
+                continue;
+            }
+        }
+#endif
+
+        uint8_t before[sizeof(RegisterFile)];
+        uint64_t pass_start = machine_.cycles;
+        if (polls) {
+            std::memcpy(before, &regs(), sizeof(before));
+        }
+        uint8_t i = 0;
+        for (; i < block.op_count && executed < max_instructions; i++) {
+            const MicroOp& op = block.ops[i];
+            regs().set(PC_, regs().get(PC_) + op.length);
+            operand_ = op.operand;
+            (this->*op.handler)();
+            account_cycles(op.opcode);
+            executed++;
+
+            // the block just overwrote its own code or made the CPU yield
+            if (block.generation != gameboy.mmu.page_generation(pc) || machine_.cpu.yield) {
+                i++;
+                break;
+            }
+        }
+
+        // a whole pass that ended where it began: let run_until() skip the rest
+        if (polls && i == block.op_count && !machine_.cpu.yield && regs().get(PC_) == pc &&
+            std::memcmp(before, &regs(), sizeof(before)) == 0) {
+            idle_block_ = &block;
+            idle_pass_start_ = pass_start;
+            idle_pass_cycles_ = machine_.cycles - pass_start;
+            break;
+        }
+    }
+    return executed;
+}
+
+void CPU::compile_block(BlockCache::Block& block, uint32_t key, uint16_t pc) {
+    block.key = key;
+    block.generation = gameboy.mmu.page_generation(pc);
+    block.op_count = 0;
+    block.heat = 0;
+    block.native = nullptr;
+    gameboy.mmu.watch_page(pc);
+
+    int page_end = (pc & 0xFF00) + 0x100;
+    int addr = pc;
+    while (block.op_count < BlockCache::max_block_ops) {
+        uint8_t opcode = gameboy.mmu.read(Address(addr));
+        const OpcodeInfo& info = opcode_table[opcode];
+        if (addr + info.length > page_end) {
+            break;
+        }
+
+        MicroOp& op = block.ops[block.op_count++];
+        op.opcode = opcode;
+        op.length = info.length;
+        op.operand = 0;
+        if (info.length >= 2) {
+            op.operand = gameboy.mmu.read(Address(addr + 1));
+        }
+        if (info.length == 3) {
+            op.operand |= gameboy.mmu.read(Address(addr + 2)) << 8;
+        }
+        // resolve the CB prefix now so replay skips the second dispatch
+        op.handler = opcode == 0xCB ? cb_handlers_[op.operand] : non_cb_handlers_[opcode];
+
+        addr += info.length;
+        if (BlockCache::ends_block(opcode)) {
+            break;
+        }
+    }
+    block.polls = BlockCache::polling_loop(block, pc);
+}
+
+/* Idle loops */
+void CPU::set_idle_skip_enabled(bool enabled) {
+#ifdef GB_JIT
+    // translations of polling blocks, and links into them, would bypass the check
+    if (enabled && !idle_skip_enabled_ && jit_) {
+        jit_->flush(block_cache_);
+    }
+#endif
+    idle_skip_enabled_ = enabled;
+    idle_block_ = nullptr;
+}
+
+int CPU::polled_address(const MicroOp& op) const {
+    uint16_t hl = regs().get(HL_);
+    switch (op.opcode) {
+        case 0xF0: return 0xFF00 | (op.operand & 0xFF);
+        case 0xF2: return 0xFF00 | regs().get(C_);
+        case 0xFA: return op.operand;
+        case 0x0A: return regs().get(BC_);
+        case 0x1A: return regs().get(DE_);
+        case 0x2A: case 0x3A: return hl;
+        case 0xCB: return (op.operand & 0x07) == 0x06 ? hl : -1;
+        case 0x76: return -1;
+        default:
+            // LD r,(HL) and the ALU ops on (HL)
+            return (op.opcode & 0xC7) == 0x46 || (op.opcode & 0xC7) == 0x86 ? hl : -1;
+    }
+}
+
+// The pass run_blocks() just checked read the same values from
+// idle_pass_start_ on; every further pass that ends before anything it
+// reads can change, and before stop, would do exactly the same.
+void CPU::skip_idle(uint64_t stop) {
+    const BlockCache::Block& block = *idle_block_;
+    idle_block_ = nullptr;
+    uint64_t until = stop;
+    for (uint8_t i = 0; i < block.op_count; i++) {
+        int address = polled_address(block.ops[i]);
+        if (address >= 0) {
+            until = std::min(until, gameboy.mmu.stable_until(static_cast<uint16_t>(address), idle_pass_start_));
+        }
+    }
+    if (until <= machine_.cycles || idle_pass_cycles_ == 0) {
+        return;
+    }
+    uint64_t passes = (until - machine_.cycles) / idle_pass_cycles_;
+    if (passes == 0) {
+        return;
+    }
+    machine_.cycles += passes * idle_pass_cycles_;
+    machine_.cpu.retired += passes * block.op_count;
+    idle_stats_.skips++;
+    idle_stats_.skipped_cycles += passes * idle_pass_cycles_;
+    idle_stats_.skipped_instructions += passes * block.op_count;
+}
+
+#ifdef GB_JIT
+/* Dynamic recompiler */
+void CPU::set_jit_enabled(bool enabled) {
+    if (!enabled) {
+        if (jit_) {
+            jit_->flush(block_cache_);
+        }
+        jit_.reset();
+        return;
+    }
+    if (!jit_) {
+        jit_ = std::make_unique<Jit>();
+        if (!jit_->available()) {
+            jit_.reset();
+            return;
+        }
+    }
+    set_block_cache_enabled(true);
+}
+
+uint64_t CPU::run_native(void* entry, uint64_t max_instructions) {
+    if (!jit_differential) {
+        return jit_->enter(*this, entry, max_instructions);
+    }
+
+    MachineState& state = machine_;
+    if (!differential_before_) {
+        differential_before_ = std::make_unique<MachineState>();
+        differential_native_ = std::make_unique<MachineState>();
+    }
+    std::size_t bytes = state.used_bytes(gameboy.mmu.cartridge_ram_size());
+    std::memcpy(differential_before_.get(), &state, bytes);
+    MMU mapping_before(state);
+    mapping_before.copy_mapping(gameboy.mmu);
+    gameboy.hold_output();
+    uint16_t pc = regs().get(PC_);
+
+    uint64_t executed = jit_->enter(*this, entry, max_instructions);
+    std::memcpy(differential_native_.get(), &state, bytes);
+
+    // replay the same instructions through the interpreter, its result stands
+    std::memcpy(&state, differential_before_.get(), bytes);
+    gameboy.mmu.copy_mapping(mapping_before);
+    gameboy.restore_output();
+    run_interpreter(executed);
+    bool match = std::memcmp(&state, differential_native_.get(), bytes) == 0;
+
+    JitStats& stats = jit_->stats;
+    stats.differential_checks++;
+    if (!match && stats.differential_mismatches++ == 0) {
+        stats.first_mismatch_pc = pc;
+    }
+    return executed;
+}
+#endif
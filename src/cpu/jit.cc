@@ -0,0 +1,305 @@
+#ifdef GB_JIT
+
+#include "jit.h"
+#include <cstring>
+#include <sys/mman.h>
+#include "cpu.h"
+
+namespace {
+
+// Worst case native size of one block: prologue, 16 handler calls, 3 links
+constexpr std::size_t max_block_bytes = 2048;
+
+// Byte offset of member from the CPU's arena state, for [rbx+disp32] operands
+int32_t state_offset(const CpuState& state, const void* member) {
+    return static_cast<int32_t>(static_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(&state));
+}
+
+// Register operand of LD r,r' / LD r,n, encoded in three opcode bits
+bool reg8_operand(uint8_t code, Reg8& reg) {
+    static constexpr Reg8 regs[8] = {
+        Reg8::B, Reg8::C, Reg8::D, Reg8::E, Reg8::H, Reg8::L, Reg8::A, Reg8::A
+    };
+    if (code == 6) {
+        return false; // (HL)
+    }
+    reg = regs[code];
+    return true;
+}
+
+// Static successors of the last instruction of a block, i.e. PCs that can be
+// linked. Returns the number of targets written.
+int link_targets(const MicroOp& op, uint16_t next_pc, bool ended_by_opcode, uint16_t targets[2]) {
+    if (!ended_by_opcode) {
+        targets[0] = next_pc;
+        return 1;
+    }
+    uint16_t jr_target = next_pc + static_cast<int8_t>(op.operand);
+    switch (op.opcode) {
+        case 0x18: targets[0] = jr_target; return 1;
+        case 0x20: case 0x28: case 0x30: case 0x38:
+            targets[0] = jr_target;
+            targets[1] = next_pc;
+            return 2;
+        case 0xC3: case 0xCD: targets[0] = op.operand; return 1;
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC: // CALL cc
+            targets[0] = op.operand;
+            targets[1] = next_pc;
+            return 2;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            targets[0] = op.opcode & 0x38;
+            return 1;
+        default:
+            // RET and JP (HL) go wherever the stack or HL says, HALT, STOP,
+            // DI, EI and illegal opcodes go back to the dispatcher
+            return 0;
+    }
+}
+
+}
+
+Jit::Jit() {
+    void* mem = mmap(nullptr, code_cache_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return;
+    }
+    code_ = static_cast<uint8_t*>(mem);
+
+    // uint64_t trampoline(CpuState* state, uint64_t budget, void* entry)
+    trampoline_ = reinterpret_cast<uint64_t (*)(CpuState*, uint64_t, void*)>(code_);
+    emit8(0x53);                           // push rbx
+    emit8(0x41); emit8(0x54);              // push r12
+    emit8(0x41); emit8(0x55);              // push r13
+    emit8(0x48); emit8(0x89); emit8(0xFB); // mov rbx, rdi
+    emit8(0x49); emit8(0x89); emit8(0xF4); // mov r12, rsi
+    emit8(0x49); emit8(0x89); emit8(0xF5); // mov r13, rsi
+    emit8(0xFF); emit8(0xE2);              // jmp rdx
+
+    // Every block exits here; returns how much of the budget was used
+    exit_stub_ = code_ + used_;
+    emit8(0x4C); emit8(0x89); emit8(0xE8); // mov rax, r13
+    emit8(0x4C); emit8(0x29); emit8(0xE0); // sub rax, r12
+    emit8(0x41); emit8(0x5D);              // pop r13
+    emit8(0x41); emit8(0x5C);              // pop r12
+    emit8(0x5B);                           // pop rbx
+    emit8(0xC3);                           // ret
+
+    reset_point_ = used_;
+}
+
+Jit::~Jit() {
+    if (code_) {
+        munmap(code_, code_cache_size);
+    }
+}
+
+void Jit::emit16(uint16_t val) {
+    std::memcpy(code_ + used_, &val, sizeof(val));
+    used_ += sizeof(val);
+}
+
+void Jit::emit32(uint32_t val) {
+    std::memcpy(code_ + used_, &val, sizeof(val));
+    used_ += sizeof(val);
+}
+
+void Jit::emit64(uint64_t val) {
+    std::memcpy(code_ + used_, &val, sizeof(val));
+    used_ += sizeof(val);
+}
+
+// ModRM + disp32 for [rbx+disp]
+void Jit::emit_rbx_disp(uint8_t modrm_reg, int32_t disp) {
+    emit8(0x80 | (modrm_reg << 3) | 0x3);
+    emit32(static_cast<uint32_t>(disp));
+}
+
+uint8_t* Jit::emit_jump(uint8_t opcode_prefix, uint8_t opcode) {
+    if (opcode_prefix) {
+        emit8(opcode_prefix);
+    }
+    emit8(opcode);
+    uint8_t* slot = code_ + used_;
+    emit32(0);
+    return slot;
+}
+
+void Jit::patch(uint8_t* rel32_slot, const uint8_t* target) {
+    int32_t rel = static_cast<int32_t>(target - (rel32_slot + 4));
+    std::memcpy(rel32_slot, &rel, sizeof(rel));
+}
+
+// Gives back the budget of instructions the block did not run and leaves
+void Jit::emit_exit(uint32_t unexecuted) {
+    if (unexecuted) {
+        emit8(0x49); emit8(0x81); emit8(0xC4); emit32(unexecuted); // add r12, imm32
+    }
+    patch(emit_jump(0, 0xE9), exit_stub_); // jmp exit
+}
+
+bool Jit::call_handler(CPU* cpu, const HandlerCall* call) {
+    cpu->operand_ = call->op.operand;
+    (cpu->*call->op.handler)();
+    cpu->account_cycles(call->op.opcode);
+    return cpu->gameboy.mmu.page_generation(call->block_pc) == call->generation && !cpu->machine_.cpu.yield;
+}
+
+void* Jit::translate(CPU& cpu, BlockCache::Block& block, uint16_t pc) {
+    if (!code_ || block.op_count == 0) {
+        return nullptr;
+    }
+    if (used_ + max_block_bytes > code_cache_size) {
+        flush(cpu.block_cache_);
+    }
+
+    MMU& mmu = cpu.gameboy.mmu;
+    const CpuState& state = cpu.machine_.cpu;
+    const int32_t pc_offset = state_offset(state, &state.regs.pc_);
+    auto reg8_offset = [&](Reg8 reg) { return state_offset(state, &state.regs.r8_[static_cast<uint8_t>(reg)]); };
+    auto reg16_offset = [&](uint8_t pair) {
+        // BC, DE, HL, SP in opcode bit order
+        if (pair == 3) {
+            return state_offset(state, &state.regs.sp_);
+        }
+        return state_offset(state, &state.regs.r8_[pair * 2]);
+    };
+
+    uint8_t* entry = code_ + used_;
+    auto old = entries_.find(block.key);
+    if (old != entries_.end()) {
+        // blocks linked to the stale translation get forwarded to this one
+        uint8_t* old_entry = old->second;
+        old_entry[0] = 0xE9;
+        patch(old_entry + 1, entry);
+    }
+    entries_[block.key] = entry;
+
+    /* Prologue */
+    std::vector<uint8_t*> exits;
+    emit8(0x49); emit8(0x81); emit8(0xFC); emit32(block.op_count); // cmp r12, op_count
+    exits.push_back(emit_jump(0x0F, 0x82));                         // jb exit
+    emit8(0x48); emit8(0xB8); emit64(reinterpret_cast<uint64_t>(mmu.page_generation_ptr(pc))); // mov rax, &generation
+    emit8(0x81); emit8(0x38); emit32(block.generation);             // cmp dword [rax], generation
+    exits.push_back(emit_jump(0x0F, 0x85));                         // jne exit
+    if (pc >= 0x4000 && pc < 0x8000) {
+        emit8(0x48); emit8(0xB8); emit64(reinterpret_cast<uint64_t>(mmu.rom_bank_ptr())); // mov rax, &rom_bank
+        emit8(0x66); emit8(0x81); emit8(0x38); emit16(block.key >> 16); // cmp word [rax], bank
+        exits.push_back(emit_jump(0x0F, 0x85));                         // jne exit
+    }
+    emit8(0x49); emit8(0x81); emit8(0xEC); emit32(block.op_count); // sub r12, op_count
+
+    // Native instructions have fixed costs, added up and charged to
+    // the cycle counter before the next handler call or the block's end
+    uint32_t pending_cycles = 0;
+    auto emit_pending_cycles = [&]() {
+        if (pending_cycles) {
+            emit8(0x48); emit8(0x81); emit_rbx_disp(0, state_offset(state, &cpu.machine_.cycles)); // add qword [cycles], imm32
+            emit32(pending_cycles);
+            pending_cycles = 0;
+        }
+    };
+
+    /* Body */
+    uint16_t addr = pc;
+    for (uint8_t i = 0; i < block.op_count; i++) {
+        const MicroOp& op = block.ops[i];
+        uint8_t opcode = op.opcode;
+        addr += op.length;
+
+        Reg8 to, from;
+        if (opcode >= 0x40 && opcode < 0x80 && reg8_operand((opcode >> 3) & 0x7, to) && reg8_operand(opcode & 0x7, from)) {
+            // LD r, r'
+            emit8(0x8A); emit_rbx_disp(0, reg8_offset(from)); // mov al, [from]
+            emit8(0x88); emit_rbx_disp(0, reg8_offset(to));   // mov [to], al
+        } else if ((opcode & 0xC7) == 0x06 && reg8_operand((opcode >> 3) & 0x7, to)) {
+            // LD r, n
+            emit8(0xC6); emit_rbx_disp(0, reg8_offset(to)); emit8(op.operand & 0xFF);
+        } else if ((opcode & 0xCF) == 0x01) {
+            // LD rr, nn
+            emit8(0x66); emit8(0xC7); emit_rbx_disp(0, reg16_offset(opcode >> 4)); emit16(op.operand);
+        } else if ((opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B) {
+            // INC rr / DEC rr
+            emit8(0x66); emit8(0xFF); emit_rbx_disp(opcode & 0x08 ? 1 : 0, reg16_offset(opcode >> 4));
+        } else if (opcode == 0x00) {
+            // NOP
+        } else {
+            emit_pending_cycles();
+            calls_.push_back(HandlerCall{op, pc, block.generation});
+            emit8(0x66); emit8(0xC7); emit_rbx_disp(0, pc_offset); emit16(addr);   // mov word [pc], next pc
+            emit8(0x48); emit8(0xBF); emit64(reinterpret_cast<uint64_t>(&cpu));   // mov rdi, cpu
+            emit8(0x48); emit8(0xBE); emit64(reinterpret_cast<uint64_t>(&calls_.back())); // mov rsi, &call
+            emit8(0x48); emit8(0xB8); emit64(reinterpret_cast<uint64_t>(&Jit::call_handler)); // mov rax, call_handler
+            emit8(0xFF); emit8(0xD0);                                              // call rax
+            // the handler overwrote this block's code or made the CPU
+            // yield, stop here rather than following a link
+            emit8(0x84); emit8(0xC0); // test al, al
+            emit8(0x75);              // jnz over the exit
+            std::size_t skip = used_++;
+            emit_exit(block.op_count - i - 1);
+            code_[skip] = static_cast<uint8_t>(used_ - skip - 1);
+            continue;
+        }
+        pending_cycles += opcode_table[opcode].cycles;
+        if (i + 1 == block.op_count) {
+            emit_pending_cycles();
+            emit8(0x66); emit8(0xC7); emit_rbx_disp(0, pc_offset); emit16(addr); // mov word [pc], next pc
+        }
+    }
+
+    /* Links */
+    const MicroOp& last = block.ops[block.op_count - 1];
+    uint16_t targets[2];
+    int target_count = link_targets(last, addr, BlockCache::ends_block(last.opcode), targets);
+    for (int i = 0; i < target_count; i++) {
+        if (!BlockCache::cacheable(targets[i])) {
+            continue;
+        }
+        emit8(0x66); emit8(0x81); emit_rbx_disp(7, pc_offset); emit16(targets[i]); // cmp word [pc], target
+        emit8(0x75); emit8(0x05);                                                // jne next link
+        uint8_t* slot = emit_jump(0, 0xE9);                                      // jmp target block
+        uint32_t target_key = BlockCache::key(targets[i], mmu.rom_bank());
+        auto target = entries_.find(target_key);
+        if (target != entries_.end()) {
+            patch(slot, target->second);
+            stats.links++;
+        } else {
+            patch(slot, exit_stub_);
+            pending_links_.emplace(target_key, slot);
+        }
+    }
+    emit_exit(0);
+
+    // a block that cannot run leaves with PC still on its first instruction
+    for (uint8_t* slot : exits) {
+        patch(slot, exit_stub_);
+    }
+
+    // blocks translated earlier that jump here
+    auto waiting = pending_links_.equal_range(block.key);
+    for (auto it = waiting.first; it != waiting.second; ++it) {
+        patch(it->second, entry);
+        stats.links++;
+    }
+    pending_links_.erase(waiting.first, waiting.second);
+
+    stats.blocks_translated++;
+    return entry;
+}
+
+uint64_t Jit::enter(CPU& cpu, void* entry, uint64_t budget) {
+    stats.native_entries++;
+    return trampoline_(&cpu.machine_.cpu, budget, entry);
+}
+
+void Jit::flush(BlockCache& block_cache) {
+    used_ = reset_point_;
+    entries_.clear();
+    pending_links_.clear();
+    calls_.clear();
+    block_cache.drop_native();
+    stats.flushes++;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef JIT_H
+#define JIT_H
+
+#ifdef GB_JIT
+
+#if !defined(__x86_64__) || !(defined(__linux__) || defined(__APPLE__))
+#error "GB_JIT needs an x86-64 POSIX host"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "block_cache.h"
+
+class CPU;
+struct CpuState;
+
+struct JitStats {
+    uint64_t blocks_translated = 0;
+    uint64_t native_entries = 0;  // times the dispatcher entered native code
+    uint64_t links = 0;           // block exits patched to jump straight to another block
+    uint64_t flushes = 0;         // code cache resets after running out of space
+    uint64_t differential_checks = 0;
+    uint64_t differential_mismatches = 0;
+    uint16_t first_mismatch_pc = 0;
+};
+
+/* x86-64 dynamic recompiler
+ * Translates hot BlockCache blocks into native code in an executable code
+ * cache. Plain register moves (LD r,r / LD r,n / LD rr,nn / INC rr / DEC rr /
+ * NOP) become x86 moves on the register file; every other instruction is a
+ * call to its interpreter handler through call_handler, so memory, I/O and
+ * flags keep exactly the interpreter's semantics.
+ *
+ * Generated code runs with rbx = the CPU's CpuState in the machine state
+ * arena, r12 = remaining instruction budget and r13 = the budget on entry;
+ * the CPU* for handler calls is baked into the code. Each block starts by
+ * checking the budget, its page's code generation and, for 0x4000-0x7FFF,
+ * the ROM bank, so a stale or unaffordable block falls back to the
+ * dispatcher with PC still on the block start. Exits with a target known
+ * at translation time (fall through, JR/JP/CALL/RST) are linked to the
+ * target block once it has been translated; a handler call that
+ * invalidates the running block or makes the CPU yield (see
+ * CpuState::yield) exits straight away.
+ */
+class Jit {
+    public:
+        static constexpr uint32_t hot_threshold = 32;
+        static constexpr std::size_t code_cache_size = 4 << 20;
+
+        Jit();
+        ~Jit();
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        bool available() const { return code_ != nullptr; }
+
+        // Returns the native entry for block (decoded at pc), or nullptr if
+        // the host refused an executable mapping
+        void* translate(CPU& cpu, BlockCache::Block& block, uint16_t pc);
+
+        // Runs native code from entry until a block exits to the dispatcher.
+        // Returns the number of guest instructions executed.
+        uint64_t enter(CPU& cpu, void* entry, uint64_t budget);
+
+        // Drops every translation, e.g. when the machine state is replaced
+        void flush(BlockCache& block_cache);
+
+        JitStats stats;
+
+    private:
+        // Arguments of one handler call, kept at a stable address for the generated code
+        struct HandlerCall {
+            MicroOp op;
+            uint16_t block_pc;
+            uint32_t generation;
+        };
+
+        static bool call_handler(CPU* cpu, const HandlerCall* call);
+
+        void emit8(uint8_t val) { code_[used_++] = val; }
+        void emit16(uint16_t val);
+        void emit32(uint32_t val);
+        void emit64(uint64_t val);
+        void emit_rbx_disp(uint8_t modrm_reg, int32_t disp);
+        uint8_t* emit_jump(uint8_t opcode_prefix, uint8_t opcode); // returns the rel32 slot
+        void patch(uint8_t* rel32_slot, const uint8_t* target);
+        void emit_exit(uint32_t unexecuted);
+
+        uint8_t* code_ = nullptr;
+        std::size_t used_ = 0;
+        std::size_t reset_point_ = 0;
+        uint8_t* exit_stub_ = nullptr;
+        uint64_t (*trampoline_)(CpuState*, uint64_t, void*) = nullptr;
+
+        std::unordered_map<uint32_t, uint8_t*> entries_;
+        std::unordered_multimap<uint32_t, uint8_t*> pending_links_;
+        std::deque<HandlerCall> calls_;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef OPCODE_TABLE_H
+#define OPCODE_TABLE_H
+
+#include <array>
+#include <cstdint>
+
+// Kind of immediate operand that follows an opcode
+enum class OperandKind : uint8_t {
+    None,
+    Imm8,    // n8 / a8
+    Imm16,   // n16 / a16, little-endian
+    Signed8  // e8
+};
+
+struct OpcodeInfo {
+    uint8_t opcode;
+    const char* mnemonic;
+    uint8_t length;        // bytes, including the opcode itself
+    uint8_t cycles;        // M-cycles; for conditional ops, when the condition fails
+    uint8_t cycles_taken;  // M-cycles when a conditional branch is taken
+    OperandKind operand;
+};
+
+/** Base opcode descriptors, one row per opcode in order
+ * X(opcode, mnemonic, length, cycles, cycles_taken, operand kind)
+ *
+ * This list is the single source for the metadata table below, the
+ * CPU::opcode_xx declarations and the CPU dispatch table. 0xCB has no cost
+ * of its own: the whole prefixed instruction is described by cb_opcode_table.
+ */
+#define BASE_OPCODES(X) \
+    X(00, "NOP", 1, 1, 1, None) \
+    X(01, "LD BC,n16", 3, 3, 3, Imm16) \
+    X(02, "LD (BC),A", 1, 2, 2, None) \
+    X(03, "INC BC", 1, 2, 2, None) \
+    X(04, "INC B", 1, 1, 1, None) \
+    X(05, "DEC B", 1, 1, 1, None) \
+    X(06, "LD B,n8", 2, 2, 2, Imm8) \
+    X(07, "RLCA", 1, 1, 1, None) \
+    X(08, "LD (a16),SP", 3, 5, 5, Imm16) \
+    X(09, "ADD HL,BC", 1, 2, 2, None) \
+    X(0a, "LD A,(BC)", 1, 2, 2, None) \
+    X(0b, "DEC BC", 1, 2, 2, None) \
+    X(0c, "INC C", 1, 1, 1, None) \
+    X(0d, "DEC C", 1, 1, 1, None) \
+    X(0e, "LD C,n8", 2, 2, 2, Imm8) \
+    X(0f, "RRCA", 1, 1, 1, None) \
+    X(10, "STOP", 2, 1, 1, Imm8) \
+    X(11, "LD DE,n16", 3, 3, 3, Imm16) \
+    X(12, "LD (DE),A", 1, 2, 2, None) \
+    X(13, "INC DE", 1, 2, 2, None) \
+    X(14, "INC D", 1, 1, 1, None) \
+    X(15, "DEC D", 1, 1, 1, None) \
+    X(16, "LD D,n8", 2, 2, 2, Imm8) \
+    X(17, "RLA", 1, 1, 1, None) \
+    X(18, "JR e8", 2, 3, 3, Signed8) \
+    X(19, "ADD HL,DE", 1, 2, 2, None) \
+    X(1a, "LD A,(DE)", 1, 2, 2, None) \
+    X(1b, "DEC DE", 1, 2, 2, None) \
+    X(1c, "INC E", 1, 1, 1, None) \
+    X(1d, "DEC E", 1, 1, 1, None) \
+    X(1e, "LD E,n8", 2, 2, 2, Imm8) \
+    X(1f, "RRA", 1, 1, 1, None) \
+    X(20, "JR NZ,e8", 2, 2, 3, Signed8) \
+    X(21, "LD HL,n16", 3, 3, 3, Imm16) \
+    X(22, "LD (HL+),A", 1, 2, 2, None) \
+    X(23, "INC HL", 1, 2, 2, None) \
+    X(24, "INC H", 1, 1, 1, None) \
+    X(25, "DEC H", 1, 1, 1, None) \
+    X(26, "LD H,n8", 2, 2, 2, Imm8) \
+    X(27, "DAA", 1, 1, 1, None) \
+    X(28, "JR Z,e8", 2, 2, 3, Signed8) \
+    X(29, "ADD HL,HL", 1, 2, 2, None) \
+    X(2a, "LD A,(HL+)", 1, 2, 2, None) \
+    X(2b, "DEC HL", 1, 2, 2, None) \
+    X(2c, "INC L", 1, 1, 1, None) \
+    X(2d, "DEC L", 1, 1, 1, None) \
+    X(2e, "LD L,n8", 2, 2, 2, Imm8) \
+    X(2f, "CPL", 1, 1, 1, None) \
+    X(30, "JR NC,e8", 2, 2, 3, Signed8) \
+    X(31, "LD SP,n16", 3, 3, 3, Imm16) \
+    X(32, "LD (HL-),A", 1, 2, 2, None) \
+    X(33, "INC SP", 1, 2, 2, None) \
+    X(34, "INC (HL)", 1, 3, 3, None) \
+    X(35, "DEC (HL)", 1, 3, 3, None) \
+    X(36, "LD (HL),n8", 2, 3, 3, Imm8) \
+    X(37, "SCF", 1, 1, 1, None) \
+    X(38, "JR C,e8", 2, 2, 3, Signed8) \
+    X(39, "ADD HL,SP", 1, 2, 2, None) \
+    X(3a, "LD A,(HL-)", 1, 2, 2, None) \
+    X(3b, "DEC SP", 1, 2, 2, None) \
+    X(3c, "INC A", 1, 1, 1, None) \
+    X(3d, "DEC A", 1, 1, 1, None) \
+    X(3e, "LD A,n8", 2, 2, 2, Imm8) \
+    X(3f, "CCF", 1, 1, 1, None) \
+    X(40, "LD B,B", 1, 1, 1, None) \
+    X(41, "LD B,C", 1, 1, 1, None) \
+    X(42, "LD B,D", 1, 1, 1, None) \
+    X(43, "LD B,E", 1, 1, 1, None) \
+    X(44, "LD B,H", 1, 1, 1, None) \
+    X(45, "LD B,L", 1, 1, 1, None) \
+    X(46, "LD B,(HL)", 1, 2, 2, None) \
+    X(47, "LD B,A", 1, 1, 1, None) \
+    X(48, "LD C,B", 1, 1, 1, None) \
+    X(49, "LD C,C", 1, 1, 1, None) \
+    X(4a, "LD C,D", 1, 1, 1, None) \
+    X(4b, "LD C,E", 1, 1, 1, None) \
+    X(4c, "LD C,H", 1, 1, 1, None) \
+    X(4d, "LD C,L", 1, 1, 1, None) \
+    X(4e, "LD C,(HL)", 1, 2, 2, None) \
+    X(4f, "LD C,A", 1, 1, 1, None) \
+    X(50, "LD D,B", 1, 1, 1, None) \
+    X(51, "LD D,C", 1, 1, 1, None) \
+    X(52, "LD D,D", 1, 1, 1, None) \
+    X(53, "LD D,E", 1, 1, 1, None) \
+    X(54, "LD D,H", 1, 1, 1, None) \
+    X(55, "LD D,L", 1, 1, 1, None) \
+    X(56, "LD D,(HL)", 1, 2, 2, None) \
+    X(57, "LD D,A", 1, 1, 1, None) \
+    X(58, "LD E,B", 1, 1, 1, None) \
+    X(59, "LD E,C", 1, 1, 1, None) \
+    X(5a, "LD E,D", 1, 1, 1, None) \
+    X(5b, "LD E,E", 1, 1, 1, None) \
+    X(5c, "LD E,H", 1, 1, 1, None) \
+    X(5d, "LD E,L", 1, 1, 1, None) \
+    X(5e, "LD E,(HL)", 1, 2, 2, None) \
+    X(5f, "LD E,A", 1, 1, 1, None) \
+    X(60, "LD H,B", 1, 1, 1, None) \
+    X(61, "LD H,C", 1, 1, 1, None) \
+    X(62, "LD H,D", 1, 1, 1, None) \
+    X(63, "LD H,E", 1, 1, 1, None) \
+    X(64, "LD H,H", 1, 1, 1, None) \
+    X(65, "LD H,L", 1, 1, 1, None) \
+    X(66, "LD H,(HL)", 1, 2, 2, None) \
+    X(67, "LD H,A", 1, 1, 1, None) \
+    X(68, "LD L,B", 1, 1, 1, None) \
+    X(69, "LD L,C", 1, 1, 1, None) \
+    X(6a, "LD L,D", 1, 1, 1, None) \
+    X(6b, "LD L,E", 1, 1, 1, None) \
+    X(6c, "LD L,H", 1, 1, 1, None) \
+    X(6d, "LD L,L", 1, 1, 1, None) \
+    X(6e, "LD L,(HL)", 1, 2, 2, None) \
+    X(6f, "LD L,A", 1, 1, 1, None) \
+    X(70, "LD (HL),B", 1, 2, 2, None) \
+    X(71, "LD (HL),C", 1, 2, 2, None) \
+    X(72, "LD (HL),D", 1, 2, 2, None) \
+    X(73, "LD (HL),E", 1, 2, 2, None) \
+    X(74, "LD (HL),H", 1, 2, 2, None) \
+    X(75, "LD (HL),L", 1, 2, 2, None) \
+    X(76, "HALT", 1, 1, 1, None) \
+    X(77, "LD (HL),A", 1, 2, 2, None) \
+    X(78, "LD A,B", 1, 1, 1, None) \
+    X(79, "LD A,C", 1, 1, 1, None) \
+    X(7a, "LD A,D", 1, 1, 1, None) \
+    X(7b, "LD A,E", 1, 1, 1, None) \
+    X(7c, "LD A,H", 1, 1, 1, None) \
+    X(7d, "LD A,L", 1, 1, 1, None) \
+    X(7e, "LD A,(HL)", 1, 2, 2, None) \
+    X(7f, "LD A,A", 1, 1, 1, None) \
+    X(80, "ADD A,B", 1, 1, 1, None) \
+    X(81, "ADD A,C", 1, 1, 1, None) \
+    X(82, "ADD A,D", 1, 1, 1, None) \
+    X(83, "ADD A,E", 1, 1, 1, None) \
+    X(84, "ADD A,H", 1, 1, 1, None) \
+    X(85, "ADD A,L", 1, 1, 1, None) \
+    X(86, "ADD A,(HL)", 1, 2, 2, None) \
+    X(87, "ADD A,A", 1, 1, 1, None) \
+    X(88, "ADC A,B", 1, 1, 1, None) \
+    X(89, "ADC A,C", 1, 1, 1, None) \
+    X(8a, "ADC A,D", 1, 1, 1, None) \
+    X(8b, "ADC A,E", 1, 1, 1, None) \
+    X(8c, "ADC A,H", 1, 1, 1, None) \
+    X(8d, "ADC A,L", 1, 1, 1, None) \
+    X(8e, "ADC A,(HL)", 1, 2, 2, None) \
+    X(8f, "ADC A,A", 1, 1, 1, None) \
+    X(90, "SUB B", 1, 1, 1, None) \
+    X(91, "SUB C", 1, 1, 1, None) \
+    X(92, "SUB D", 1, 1, 1, None) \
+    X(93, "SUB E", 1, 1, 1, None) \
+    X(94, "SUB H", 1, 1, 1, None) \
+    X(95, "SUB L", 1, 1, 1, None) \
+    X(96, "SUB (HL)", 1, 2, 2, None) \
+    X(97, "SUB A", 1, 1, 1, None) \
+    X(98, "SBC A,B", 1, 1, 1, None) \
+    X(99, "SBC A,C", 1, 1, 1, None) \
+    X(9a, "SBC A,D", 1, 1, 1, None) \
+    X(9b, "SBC A,E", 1, 1, 1, None) \
+    X(9c, "SBC A,H", 1, 1, 1, None) \
+    X(9d, "SBC A,L", 1, 1, 1, None) \
+    X(9e, "SBC A,(HL)", 1, 2, 2, None) \
+    X(9f, "SBC A,A", 1, 1, 1, None) \
+    X(a0, "AND B", 1, 1, 1, None) \
+    X(a1, "AND C", 1, 1, 1, None) \
+    X(a2, "AND D", 1, 1, 1, None) \
+    X(a3, "AND E", 1, 1, 1, None) \
+    X(a4, "AND H", 1, 1, 1, None) \
+    X(a5, "AND L", 1, 1, 1, None) \
+    X(a6, "AND (HL)", 1, 2, 2, None) \
+    X(a7, "AND A", 1, 1, 1, None) \
+    X(a8, "XOR B", 1, 1, 1, None) \
+    X(a9, "XOR C", 1, 1, 1, None) \
+    X(aa, "XOR D", 1, 1, 1, None) \
+    X(ab, "XOR E", 1, 1, 1, None) \
+    X(ac, "XOR H", 1, 1, 1, None) \
+    X(ad, "XOR L", 1, 1, 1, None) \
+    X(ae, "XOR (HL)", 1, 2, 2, None) \
+    X(af, "XOR A", 1, 1, 1, None) \
+    X(b0, "OR B", 1, 1, 1, None) \
+    X(b1, "OR C", 1, 1, 1, None) \
+    X(b2, "OR D", 1, 1, 1, None) \
+    X(b3, "OR E", 1, 1, 1, None) \
+    X(b4, "OR H", 1, 1, 1, None) \
+    X(b5, "OR L", 1, 1, 1, None) \
+    X(b6, "OR (HL)", 1, 2, 2, None) \
+    X(b7, "OR A", 1, 1, 1, None) \
+    X(b8, "CP B", 1, 1, 1, None) \
+    X(b9, "CP C", 1, 1, 1, None) \
+    X(ba, "CP D", 1, 1, 1, None) \
+    X(bb, "CP E", 1, 1, 1, None) \
+    X(bc, "CP H", 1, 1, 1, None) \
+    X(bd, "CP L", 1, 1, 1, None) \
+    X(be, "CP (HL)", 1, 2, 2, None) \
+    X(bf, "CP A", 1, 1, 1, None) \
+    X(c0, "RET NZ", 1, 2, 5, None) \
+    X(c1, "POP BC", 1, 3, 3, None) \
+    X(c2, "JP NZ,a16", 3, 3, 4, Imm16) \
+    X(c3, "JP a16", 3, 4, 4, Imm16) \
+    X(c4, "CALL NZ,a16", 3, 3, 6, Imm16) \
+    X(c5, "PUSH BC", 1, 4, 4, None) \
+    X(c6, "ADD A,n8", 2, 2, 2, Imm8) \
+    X(c7, "RST $00", 1, 4, 4, None) \
+    X(c8, "RET Z", 1, 2, 5, None) \
+    X(c9, "RET", 1, 4, 4, None) \
+    X(ca, "JP Z,a16", 3, 3, 4, Imm16) \
+    X(cb, "PREFIX CB", 2, 0, 0, Imm8) \
+    X(cc, "CALL Z,a16", 3, 3, 6, Imm16) \
+    X(cd, "CALL a16", 3, 6, 6, Imm16) \
+    X(ce, "ADC A,n8", 2, 2, 2, Imm8) \
+    X(cf, "RST $08", 1, 4, 4, None) \
+    X(d0, "RET NC", 1, 2, 5, None) \
+    X(d1, "POP DE", 1, 3, 3, None) \
+    X(d2, "JP NC,a16", 3, 3, 4, Imm16) \
+    X(d3, "ILLEGAL", 1, 1, 1, None) \
+    X(d4, "CALL NC,a16", 3, 3, 6, Imm16) \
+    X(d5, "PUSH DE", 1, 4, 4, None) \
+    X(d6, "SUB n8", 2, 2, 2, Imm8) \
+    X(d7, "RST $10", 1, 4, 4, None) \
+    X(d8, "RET C", 1, 2, 5, None) \
+    X(d9, "RETI", 1, 4, 4, None) \
+    X(da, "JP C,a16", 3, 3, 4, Imm16) \
+    X(db, "ILLEGAL", 1, 1, 1, None) \
+    X(dc, "CALL C,a16", 3, 3, 6, Imm16) \
+    X(dd, "ILLEGAL", 1, 1, 1, None) \
+    X(de, "SBC A,n8", 2, 2, 2, Imm8) \
+    X(df, "RST $18", 1, 4, 4, None) \
+    X(e0, "LDH (a8),A", 2, 3, 3, Imm8) \
+    X(e1, "POP HL", 1, 3, 3, None) \
+    X(e2, "LDH (C),A", 1, 2, 2, None) \
+    X(e3, "ILLEGAL", 1, 1, 1, None) \
+    X(e4, "ILLEGAL", 1, 1, 1, None) \
+    X(e5, "PUSH HL", 1, 4, 4, None) \
+    X(e6, "AND n8", 2, 2, 2, Imm8) \
+    X(e7, "RST $20", 1, 4, 4, None) \
+    X(e8, "ADD SP,e8", 2, 4, 4, Signed8) \
+    X(e9, "JP HL", 1, 1, 1, None) \
+    X(ea, "LD (a16),A", 3, 4, 4, Imm16) \
+    X(eb, "ILLEGAL", 1, 1, 1, None) \
+    X(ec, "ILLEGAL", 1, 1, 1, None) \
+    X(ed, "ILLEGAL", 1, 1, 1, None) \
+    X(ee, "XOR n8", 2, 2, 2, Imm8) \
+    X(ef, "RST $28", 1, 4, 4, None) \
+    X(f0, "LDH A,(a8)", 2, 3, 3, Imm8) \
+    X(f1, "POP AF", 1, 3, 3, None) \
+    X(f2, "LDH A,(C)", 1, 2, 2, None) \
+    X(f3, "DI", 1, 1, 1, None) \
+    X(f4, "ILLEGAL", 1, 1, 1, None) \
+    X(f5, "PUSH AF", 1, 4, 4, None) \
+    X(f6, "OR n8", 2, 2, 2, Imm8) \
+    X(f7, "RST $30", 1, 4, 4, None) \
+    X(f8, "LD HL,SP+e8", 2, 3, 3, Signed8) \
+    X(f9, "LD SP,HL", 1, 2, 2, None) \
+    X(fa, "LD A,(a16)", 3, 4, 4, Imm16) \
+    X(fb, "EI", 1, 1, 1, None) \
+    X(fc, "ILLEGAL", 1, 1, 1, None) \
+    X(fd, "ILLEGAL", 1, 1, 1, None) \
+    X(fe, "CP n8", 2, 2, 2, Imm8) \
+    X(ff, "RST $38", 1, 4, 4, None)
+
+#define OPCODE_INFO_ROW(op, mnemonic, length, cycles, cycles_taken, operand) \
+    {0x##op, mnemonic, length, cycles, cycles_taken, OperandKind::operand},
+
+constexpr OpcodeInfo opcode_table[256] = {
+    BASE_OPCODES(OPCODE_INFO_ROW)
+};
+
+#undef OPCODE_INFO_ROW
+
+/* CB prefix
+ * The CB space is regular: bits 7-6 select the group (rotate/shift, BIT,
+ * RES, SET), bits 5-3 the rotate/shift kind or the bit index and bits 2-0
+ * the operand (B, C, D, E, H, L, (HL), A).
+ */
+constexpr const char* cb_operation_names[8] = {"RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL"};
+constexpr const char* cb_group_names[4] = {nullptr, "BIT", "RES", "SET"};
+constexpr const char* cb_operand_names[8] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
+
+constexpr OpcodeInfo cb_opcode_info(uint8_t opcode) {
+    bool uses_hl = (opcode & 0x7) == 6;
+    bool is_bit = (opcode >> 6) == 1;
+    // BIT n,(HL) only reads memory, everything else on (HL) reads and writes it
+    uint8_t cycles = uses_hl ? (is_bit ? 3 : 4) : 2;
+    const char* mnemonic = (opcode >> 6) == 0 ? cb_operation_names[(opcode >> 3) & 0x7] : cb_group_names[opcode >> 6];
+    return OpcodeInfo{opcode, mnemonic, 2, cycles, cycles, OperandKind::None};
+}
+
+constexpr std::array<OpcodeInfo, 256> make_cb_opcode_table() {
+    std::array<OpcodeInfo, 256> table{};
+    for (int opcode = 0; opcode < 256; opcode++) {
+        table[opcode] = cb_opcode_info(static_cast<uint8_t>(opcode));
+    }
+    return table;
+}
+
+constexpr std::array<OpcodeInfo, 256> cb_opcode_table = make_cb_opcode_table();
+
+constexpr bool opcode_table_in_order() {
+    for (int opcode = 0; opcode < 256; opcode++) {
+        if (opcode_table[opcode].opcode != opcode) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(opcode_table_in_order(), "BASE_OPCODES rows must be listed in opcode order");
+
+// Cost of the slowest instruction (taken CALL cc), so that a budget of
+// n / max_instruction_cycles instructions never runs past n M-cycles
+constexpr uint8_t max_instruction_cycles = 6;
+
+constexpr bool max_instruction_cycles_holds() {
+    for (int opcode = 0; opcode < 256; opcode++) {
+        if (opcode_table[opcode].cycles_taken > max_instruction_cycles ||
+            cb_opcode_table[opcode].cycles_taken > max_instruction_cycles) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(max_instruction_cycles_holds(), "max_instruction_cycles is below some opcode's cost");
+
+#endif
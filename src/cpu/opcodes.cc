@@ -1,22 +1,19 @@
 #include "cpu.h"
 #include "registers.h"
+#include "cb_opcodes.h"
 
 /* ADC */
 void CPU::opcode_adc_a(uint8_t addend) {
-    uint8_t old_A_val = A_.get_val();
-    bool carry_flag = F_.get_carry_flag();
+    uint8_t old_A_val = regs().get(A_);
+    bool carry_flag = regs().F.get_carry_flag();
     uint16_t res = old_A_val + carry_flag + addend;
 
-    A_.set_val(static_cast<uint8_t>(res));
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(((old_A_val & 0xF) + (addend & 0xF) + carry_flag) > 0xF);
-    F_.set_carry_flag((res & 0xFF00) != 0);
+    regs().set(A_, static_cast<uint8_t>(res));
+    regs().F.set_add(old_A_val, addend, carry_flag);
 }
 
-void CPU::opcode_adc(const ByteRegister& addend) {
-    opcode_adc_a(addend.get_val());
+void CPU::opcode_adc(Reg8 addend) {
+    opcode_adc_a(regs().get(addend));
 } // r
 
 void CPU::opcode_adc(const Address& addend) {
@@ -24,24 +21,20 @@ void CPU::opcode_adc(const Address& addend) {
 } // (rr)
 
 void CPU::opcode_adc() {
-    opcode_adc_a(get_next_byte());
+    opcode_adc_a(imm8());
 } // n
 
 /* ADD */
 void CPU::opcode_add_a(uint8_t addend) {
-    uint8_t old_A_val = A_.get_val();
+    uint8_t old_A_val = regs().get(A_);
     uint16_t res = old_A_val + addend;
 
-    A_.set_val(static_cast<uint8_t>(res));
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(((old_A_val & 0xF) + (addend & 0xF)) > 0xF);
-    F_.set_carry_flag((res & 0xFF00) != 0);
+    regs().set(A_, static_cast<uint8_t>(res));
+    regs().F.set_add(old_A_val, addend, false);
 }
 
-void CPU::opcode_add(const ByteRegister& addend) {
-    opcode_add_a(addend.get_val());
+void CPU::opcode_add(Reg8 addend) {
+    opcode_add_a(regs().get(addend));
 } // r
 
 void CPU::opcode_add(const Address& addend) {
@@ -49,40 +42,46 @@ void CPU::opcode_add(const Address& addend) {
 } // (rr)
 
 void CPU::opcode_add() {
-    opcode_add_a(get_next_byte());
+    opcode_add_a(imm8());
 } // n
 
-void CPU::opcode_add_hl() {
-    int8_t e = static_cast<int8_t>(get_next_byte());
-    uint16_t SP_val = SP_.get_val();
-    int res = static_cast<int>(SP_val + e);
+uint16_t CPU::_opcode_add_sp_e(uint8_t e) {
+    // flags come from the unsigned add on the low byte, even for negative e
+    uint16_t SP_val = regs().get(SP_);
 
-    F_.set_zero_flag(false);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag((e & 0xFF) + (SP_val & 0xFF) < 0 || (e & 0xFF) + (SP_val & 0xFF) >= 0xFF);
-    F_.set_carry_flag(res < 0 || res >= 0xFFFF);
+    regs().F.set_zero_flag(false);
+    regs().F.set_subtract_flag(false);
+    regs().F.set_half_carry_flag(((SP_val & 0xF) + (e & 0xF)) > 0xF);
+    regs().F.set_carry_flag(((SP_val & 0xFF) + e) > 0xFF);
 
-    SP_.set_val(static_cast<uint16_t>(res));
+    return SP_val + static_cast<int8_t>(e);
 }
 
-void CPU::opcode_add(const WordRegister& addend) {
-    //todo
-} // R
+void CPU::opcode_add_sp() {
+    regs().set(SP_, _opcode_add_sp_e(imm8()));
+} // SP, e
 
+void CPU::opcode_add(Reg16 addend) {
+    uint16_t old_HL_val = regs().get(HL_);
+    uint16_t addend_val = regs().get(addend);
+    uint32_t res = old_HL_val + addend_val;
+
+    regs().set(HL_, static_cast<uint16_t>(res));
+
+    regs().F.set_subtract_flag(false);
+    regs().F.set_half_carry_flag(((old_HL_val & 0xFFF) + (addend_val & 0xFFF)) > 0xFFF);
+    regs().F.set_carry_flag(res > 0xFFFF);
+} // HL, R
 
 /* AND */
 void CPU::opcode_and_a(uint8_t val) {
-    uint8_t old_A_val = A_.get_val();
-    A_.set_val(old_A_val & val);
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(true);
-    F_.set_carry_flag(false);
+    uint8_t old_A_val = regs().get(A_);
+    regs().set(A_, old_A_val & val);
+    regs().F.set_and(regs().get(A_));
 }
 
-void CPU::opcode_and(const ByteRegister& reg) {
-    opcode_and_a(reg.get_val());
+void CPU::opcode_and(Reg8 reg) {
+    opcode_and_a(regs().get(reg));
 } // r
 
 void CPU::opcode_and(const Address& reg) {
@@ -90,60 +89,38 @@ void CPU::opcode_and(const Address& reg) {
 } // (rr)
 
 void CPU::opcode_and() {
-    opcode_and_a(get_next_byte());
+    opcode_and_a(imm8());
 } // n
 
-/* BIT */
-void CPU::_opcode_bit(uint8_t bit_to_test, uint8_t val) {
-    uint8_t test_bit = (val >> bit_to_test) & 0x1;
-    F_.set_carry_flag(test_bit != 0);
-F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(true);
-}
-
-void CPU::opcode_bit(uint8_t bit_to_test, const ByteRegister& reg) {
-    _opcode_bit(bit_to_test, reg.get_val());
-}
-
-void CPU::opcode_bit(uint8_t bit_to_test, const Address& reg) {
-    _opcode_bit(bit_to_test, gameboy.mmu.read(reg));
-}
-
 /* CALL */
 void CPU::opcode_call() {
-    uint16_t nn = get_next_word();
+    uint16_t nn = imm16();
     stack_push(PC_);
-    PC_.set_val(nn);
+    regs().set(PC_, nn);
 }
 
 void CPU::opcode_call(Condition condition) {
     if (check_condition(condition)) {
+        branch_taken_ = true;
         opcode_call();
-    } else {
-        get_next_word();
     }
 }
 
 /* CCF */
 void CPU::opcode_ccf() {
-    F_.set_carry_flag(!F_.get_carry_flag());
-    F_.set_half_carry_flag(false);
-    F_.set_subtract_flag(false);
+    regs().F.set_carry_flag(!regs().F.get_carry_flag());
+    regs().F.set_half_carry_flag(false);
+    regs().F.set_subtract_flag(false);
 }
 
 /* CP */
 void CPU::opcode_cp_a(const uint8_t subtrahend) {
-    uint8_t old_A_val = A_.get_val();
-    int res = old_A_val - subtrahend;
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(((old_A_val & 0xF) - (subtrahend & 0xF)) < 0);
-    F_.set_carry_flag(res < 0);
+    uint8_t old_A_val = regs().get(A_);
+    regs().F.set_sub(old_A_val, subtrahend, false);
 }
 
-void CPU::opcode_cp(const ByteRegister& subtrahend) {
-    opcode_cp_a(subtrahend.get_val());
+void CPU::opcode_cp(Reg8 subtrahend) {
+    opcode_cp_a(regs().get(subtrahend));
 } // r
 
 void CPU::opcode_cp(const Address& subtrahend) {
@@ -151,179 +128,190 @@ void CPU::opcode_cp(const Address& subtrahend) {
 } // (rr)
 
 void CPU::opcode_cp() {
-    opcode_cp_a(get_next_byte());
+    opcode_cp_a(imm8());
 } // n
 
 /* CPL */
 void CPU::opcode_cpl() {
-    uint8_t old_A_val = A_.get_val();
-    A_.set_val(~old_A_val);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(true);
+    uint8_t old_A_val = regs().get(A_);
+    regs().set(A_, ~old_A_val);
+    regs().F.set_subtract_flag(true);
+    regs().F.set_half_carry_flag(true);
 }
 
 /* DAA */
 void CPU::opcode_daa() {
-    // TODO
+    // Adjusts A back to BCD after an ADD/SUB, using N, H and C from that op
+    uint8_t A_val = regs().get(A_);
+    uint8_t correction = 0;
+    bool carry = regs().F.get_carry_flag();
+
+    if (regs().F.get_subtract_flag()) {
+        if (regs().F.get_half_carry_flag()) correction |= 0x06;
+        if (carry) correction |= 0x60;
+        A_val -= correction;
+    } else {
+        if (regs().F.get_half_carry_flag() || (A_val & 0xF) > 0x9) correction |= 0x06;
+        if (carry || A_val > 0x99) {
+            correction |= 0x60;
+            carry = true;
+        }
+        A_val += correction;
+    }
+
+    regs().set(A_, A_val);
+    regs().F.set_zero_flag(A_val == 0);
+    regs().F.set_half_carry_flag(false);
+    regs().F.set_carry_flag(carry);
 }
 
 /* DEC */
-void CPU::opcode_dec(ByteRegister& reg) {
-    uint8_t old_reg_val = reg.get_val();
-    int res = old_reg_val - 1;
-    reg.decrement();
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(((old_reg_val & 0xF) - 1) < 0);
+void CPU::opcode_dec(Reg8 reg) {
+    uint8_t old_reg_val = regs().get(reg);
+    uint8_t res = old_reg_val - 1;
+    regs().set(reg, res);
+    regs().F.set_dec(old_reg_val);
 } // r
 
-void CPU::opcode_dec(Address& reg) {
+void CPU::opcode_dec(const Address& reg) {
     uint8_t old_reg_val = gameboy.mmu.read(reg);
-    int res = old_reg_val - 1;
-    gameboy.mmu.write(reg, static_cast<uint8_t>(res));  // TODO: check that this cast actually works lol (same with inc)
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(((old_reg_val & 0xF) - 1) < 0);
+    uint8_t res = old_reg_val - 1;
+    gameboy.mmu.write(reg, res);
+    regs().F.set_dec(old_reg_val);
 } // (rr)
 
-void CPU::opcode_dec(WordRegister& reg) {
-    reg.decrement();
+void CPU::opcode_dec(Reg16 reg) {
+    regs().decrement(reg);
 } // R
 
 /* DI */
 void CPU::opcode_di() {
-    interrupts_enabled = true;
+    machine_.cpu.ime = false;
+    machine_.cpu.ime_pending = false; // also cancels an EI just before
 }
 
 /* EI */
 void CPU::opcode_ei() {
-    interrupts_enabled = false;
+    // takes effect after the next instruction, see service_interrupts()
+    machine_.cpu.ime_pending = true;
+    machine_.cpu.yield = true;
 }
 
 /* HALT */
 void CPU::opcode_halt() {
-    halted = true;
+    machine_.cpu.halted = true;
+    machine_.cpu.yield = true;
+}
+
+/* ILLEGAL */
+void CPU::opcode_illegal() {
+    // 0xD3, 0xDB, 0xDD, 0xE3, 0xE4, 0xEB, 0xEC, 0xED, 0xF4, 0xFC, 0xFD hang the real CPU
+    machine_.cpu.locked = true;
+    machine_.cpu.yield = true;
 }
 
 /* INC */
-void CPU::opcode_inc(ByteRegister& reg) {
-    uint8_t old_reg_val = reg.get_val();
-    uint16_t res = old_reg_val + 1;
-    reg.increment();
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(((old_reg_val & 0xF) + 1) > 0xF);
+void CPU::opcode_inc(Reg8 reg) {
+    uint8_t old_reg_val = regs().get(reg);
+    uint8_t res = old_reg_val + 1;
+    regs().set(reg, res);
+    regs().F.set_inc(old_reg_val);
 } // r
 
-void CPU::opcode_inc(Address& reg) {
+void CPU::opcode_inc(const Address& reg) {
     uint8_t old_reg_val = gameboy.mmu.read(reg);
-    uint16_t res = old_reg_val + 1;
-    gameboy.mmu.write(reg, static_cast<uint8_t>(res));
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(((old_reg_val & 0xF) + 1) > 0xF);
+    uint8_t res = old_reg_val + 1;
+    gameboy.mmu.write(reg, res);
+    regs().F.set_inc(old_reg_val);
 } // (rr)
 
-void CPU::opcode_inc(WordRegister& reg) {
-    reg.increment();
+void CPU::opcode_inc(Reg16 reg) {
+    regs().increment(reg);
 } // R
 
 /* JP */
 void CPU::opcode_jp() {
-    uint16_t nn = get_next_word();
-    PC_.set_val(nn);
+    uint16_t nn = imm16();
+    regs().set(PC_, nn);
 } // nn
 
-void CPU::opcode_jp(PairRegister& reg) {
-    PC_.set_val(reg.get_val());
+void CPU::opcode_jp(Reg16 reg) {
+    regs().set(PC_, regs().get(reg));
 } // rr
 
 void CPU::opcode_jp(Condition condition) {
-    uint16_t nn = get_next_word();
+    uint16_t nn = imm16();
     if (check_condition(condition)) {
-        PC_.set_val(nn);
+        branch_taken_ = true;
+        regs().set(PC_, nn);
     }
 }
 
-
 /* JR */
 void CPU::opcode_jr() {
-    // int should be 32 bit so hopefully this works :>
-    int e = get_next_byte();
-    int old_PC_val = PC_.get_val();
-    PC_.set_val(old_PC_val + e);    
+    int e = static_cast<int8_t>(imm8());
+    int old_PC_val = regs().get(PC_);
+    regs().set(PC_, old_PC_val + e);    
 }
 
 void CPU::opcode_jr(Condition condition) {
-    int e = get_next_byte();
-    int old_PC_val = PC_.get_val();
+    int e = static_cast<int8_t>(imm8());
+    int old_PC_val = regs().get(PC_);
     if (check_condition(condition)) {
-        PC_.set_val(old_PC_val + e);
+        branch_taken_ = true;
+        regs().set(PC_, old_PC_val + e);
     }
 
 }
 
 /* LD */
-void CPU::opcode_ld(ByteRegister& to, const ByteRegister& from) {
-    to.set_val(from.get_val());
+void CPU::opcode_ld(Reg8 to, Reg8 from) {
+    regs().set(to, regs().get(from));
 } // r, r
 
-void CPU::opcode_ld(ByteRegister& to, const Address& from) {
-    to.set_val(gameboy.mmu.read(from));
+void CPU::opcode_ld(Reg8 to, const Address& from) {
+    regs().set(to, gameboy.mmu.read(from));
 } // r, (rr)
 
-void CPU::opcode_ld(const Address& to, const ByteRegister& from) {
-    gameboy.mmu.write(to, from.get_val());
+void CPU::opcode_ld(const Address& to, Reg8 from) {
+    gameboy.mmu.write(to, regs().get(from));
 } // (rr), r
 
 void CPU::opcode_ld(const Address& to) {
-    gameboy.mmu.write(to, get_next_byte());
+    gameboy.mmu.write(to, imm8());
 } // (rr), n
 
-void CPU::opcode_ld(ByteRegister& to) {
-    to.set_val(get_next_byte());
+void CPU::opcode_ld(Reg8 to) {
+    regs().set(to, imm8());
 } // r, n
 
-void CPU::opcode_ld_get_address(ByteRegister& to) {
-   to.set_val(gameboy.mmu.read(Address(get_next_word()))); 
+void CPU::opcode_ld_get_address(Reg8 to) {
+   regs().set(to, gameboy.mmu.read(Address(imm16()))); 
 } // r, (nn)
 
-void CPU::opcode_ld(const ByteRegister& from) {
-    uint16_t loc = get_next_word();
-    gameboy.mmu.write(Address(loc), from.get_val());
+void CPU::opcode_ld_set_address(Reg8 from) {
+    uint16_t loc = imm16();
+    gameboy.mmu.write(Address(loc), regs().get(from));
 } // (nn), r
 
-void CPU::opcode_ld(WordRegister& to) {
-    uint16_t nn = get_next_word();
-    to.set_val(nn);
+void CPU::opcode_ld(Reg16 to) {
+    uint16_t nn = imm16();
+    regs().set(to, nn);
 } // R, nn and rr, nn
 
-void CPU::opcode_ld(const WordRegister& from) {
-    uint16_t loc = get_next_word();
-    gameboy.mmu.write(Address(loc), from.low_byte());
-    gameboy.mmu.write(Address(loc), from.high_byte());
+void CPU::opcode_ld_set_address(Reg16 from) {
+    uint16_t loc = imm16();
+    uint16_t val = regs().get(from);
+    gameboy.mmu.write(Address(loc), val & 0xFF);
+    gameboy.mmu.write(Address(loc + 1), val >> 8);
 } // (nn), R
 
-void CPU::opcode_ld(WordRegister& to, const WordRegister& from) {
-    to.set_val(from.get_val());
+void CPU::opcode_ld(Reg16 to, Reg16 from) {
+    regs().set(to, regs().get(from));
 } // R, R
 
 void CPU::opcode_ld_hl() {
-    int8_t e = static_cast<int8_t>(get_next_byte());
-    uint16_t SP_val = SP_.get_val();
-    int res = static_cast<int>(SP_val + e);
-
-    F_.set_zero_flag(false);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag((e & 0xFF) + (SP_val & 0xFF) < 0 || (e & 0xFF) + (SP_val & 0xFF) >= 0xFF);
-    F_.set_carry_flag(res < 0 || res >= 0xFFFF);
-
-    HL_.set_val(static_cast<uint16_t>(res));
-
+    regs().set(HL_, _opcode_add_sp_e(imm8()));
 }
 
 // // TODO: 0XC1 AND 0XF8
@@ -335,27 +323,26 @@ void CPU::opcode_ld_hl() {
 // }
 
 /* LDH */
-void CPU::opcode_ldh_to_A(const ByteRegister& from) {
-    uint16_t address = 0xFF00 + from.get_val();
-    A_.set_val(gameboy.mmu.read(Address(address)));
+void CPU::opcode_ldh_to_A(Reg8 from) {
+    uint16_t address = 0xFF00 + regs().get(from);
+    regs().set(A_, gameboy.mmu.read(Address(address)));
 }
 
-void CPU::opcode_ldh_from_A(const ByteRegister& to) {
-    uint16_t address = 0xFF00 + to.get_val();
-    gameboy.mmu.write(Address(address), A_.get_val());
+void CPU::opcode_ldh_from_A(Reg8 to) {
+    uint16_t address = 0xFF00 + regs().get(to);
+    gameboy.mmu.write(Address(address), regs().get(A_));
 }
 
 void CPU::opcode_ldh_to_A() {
-    uint16_t address = 0xFF00 + get_next_byte();
-    A_.set_val(gameboy.mmu.read(Address(address)));
+    uint16_t address = 0xFF00 + imm8();
+    regs().set(A_, gameboy.mmu.read(Address(address)));
 }
 
 void CPU::opcode_ldh_from_A() {
-    uint16_t address = 0xFF00 + get_next_byte();
-    gameboy.mmu.write(Address(address), A_.get_val());
+    uint16_t address = 0xFF00 + imm8();
+    gameboy.mmu.write(Address(address), regs().get(A_));
 }
 
-
 /* NOP */
 void CPU::opcode_nop() {
     return;
@@ -363,17 +350,13 @@ void CPU::opcode_nop() {
 
 /* OR */
 void CPU::opcode_or_a(uint8_t val) {
-    uint8_t old_A_val = A_.get_val();
-    A_.set_val(old_A_val | val);
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(false);
+    uint8_t old_A_val = regs().get(A_);
+    regs().set(A_, old_A_val | val);
+    regs().F.set_or(regs().get(A_));
 }
 
-void CPU::opcode_or(const ByteRegister& reg) {
-    opcode_or_a(reg.get_val());    
+void CPU::opcode_or(Reg8 reg) {
+    opcode_or_a(regs().get(reg));    
 } // r
 
 void CPU::opcode_or(const Address& reg) {
@@ -381,87 +364,39 @@ void CPU::opcode_or(const Address& reg) {
 } // (rr)
 
 void CPU::opcode_or() {
-    opcode_or_a(get_next_byte());    
+    opcode_or_a(imm8());    
 } // n
 
 /* POP */
-void CPU::opcode_pop(WordRegister& to) {
+void CPU::opcode_pop(Reg16 to) {
     stack_pop(to);
 } // R
 
 /* PUSH */
-void CPU::opcode_push(const WordRegister& from) {
+void CPU::opcode_push(Reg16 from) {
     stack_push(from);
 } // R
 
 /* RL */
-uint8_t CPU::_opcode_rl(uint8_t val) {
-    uint8_t old_carry_bit = F_.get_carry_flag();
-    uint8_t new_carry_bit = val & 0x80;
-    uint8_t res = (val << 1) | old_carry_bit;
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(new_carry_bit == 1);
-    return res;
-}
-
-void CPU::opcode_rl(ByteRegister& reg) {
-    reg.set_val(_opcode_rl(reg.get_val()));
-}
-
-void CPU::opcode_rl(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_rl(gameboy.mmu.read(reg)));
+void CPU::opcode_rl(Reg8 reg) {
+    regs().set(reg, _opcode_rl(regs().get(reg)));
 }
 
 /* RLA */
 void CPU::opcode_rla() {
     opcode_rl(A_);
-    F_.set_zero_flag(false);
+    regs().F.set_zero_flag(false);
 }
 
 /* RLC */
-uint8_t CPU::_opcode_rlc(uint8_t val) {
-    uint8_t carry_flag = val & 0x80;
-    uint8_t res = val << 1 | carry_flag;
-
-    F_.set_carry_flag(carry_flag == 1);
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-
-    return res;
-}
-
-void CPU::opcode_rlc(ByteRegister& reg) {
-    reg.set_val(_opcode_rlc(reg.get_val()));
-}
-
-void CPU::opcode_rlc(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_rlc(gameboy.mmu.read(reg)));
+void CPU::opcode_rlc(Reg8 reg) {
+    regs().set(reg, _opcode_rlc(regs().get(reg)));
 }
 
 /* RLCA */
 void CPU::opcode_rlca() {
     opcode_rlc(A_);
-    F_.set_zero_flag(false);
-}
-
-/* RES */
-uint8_t CPU::_opcode_res(uint8_t bit_to_reset, uint8_t val) {
-    // bit 7 is left, 0 is right
-    uint8_t mask = ~(1 << bit_to_reset);
-    uint8_t res = val & mask;
-    return res;
-}
-
-void CPU::opcode_res(uint8_t bit_to_reset, ByteRegister& reg) {
-    reg.set_val(_opcode_res(bit_to_reset, reg.get_val()));
-}
-
-void CPU::opcode_res(uint8_t bit_to_reset, Address& reg) {
-    gameboy.mmu.write(reg, _opcode_res(bit_to_reset, gameboy.mmu.read(reg)));
+    regs().F.set_zero_flag(false);
 }
 
 /* RET */
@@ -471,6 +406,7 @@ void CPU::opcode_ret() {
 
 void CPU::opcode_ret(Condition condition) {
     if (check_condition(condition)) {
+        branch_taken_ = true;
         opcode_ret();
     }
 }
@@ -478,85 +414,51 @@ void CPU::opcode_ret(Condition condition) {
 /* RETI */
 void CPU::opcode_reti() {
     opcode_ret();
-    IME_ = true;
+    machine_.cpu.ime = true;
+    machine_.cpu.yield = true;
 }
 
 /* RR*/
-uint8_t CPU::_opcode_rr(uint8_t val) {
-    uint8_t old_carry_bit = F_.get_carry_flag();
-    uint8_t new_carry_bit = val & 0x01;
-    uint8_t res = (val >> 1) | (old_carry_bit << 7);
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(new_carry_bit == 1);
-    return res;
-}
-
-void CPU::opcode_rr(ByteRegister& reg) {
-    reg.set_val(_opcode_rr(reg.get_val()));
-}
-
-void CPU::opcode_rr(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_rr(gameboy.mmu.read(reg)));
+void CPU::opcode_rr(Reg8 reg) {
+    regs().set(reg, _opcode_rr(regs().get(reg)));
 }
 
 /* RRA */
 void CPU::opcode_rra() {
     opcode_rr(A_);
-    F_.set_zero_flag(false);
+    regs().F.set_zero_flag(false);
 }
 
 /* RRC */
-uint8_t CPU::_opcode_rrc(uint8_t val) {
-    uint8_t carry_flag = val & 0x01;
-    uint8_t res = val >> 1 | (carry_flag << 7);
-
-    F_.set_carry_flag(carry_flag == 1);
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-
-    return res;
-}
-
-void CPU::opcode_rrc(ByteRegister& reg) {
-    reg.set_val(_opcode_rrc(reg.get_val()));
-}
-
-void CPU::opcode_rrc(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_rrc(gameboy.mmu.read(reg)));
+void CPU::opcode_rrc(Reg8 reg) {
+    regs().set(reg, _opcode_rrc(regs().get(reg)));
 }
 
 /* RRCA */
 void CPU::opcode_rrca() {
-    opcode_rlc(A_);
-    F_.set_zero_flag(false);
+    opcode_rrc(A_);
+    regs().F.set_zero_flag(false);
 }
 
 /* RST */
 void CPU::opcode_rst(uint8_t index) {
+    // index 0-7 selects vector 0x00, 0x08, ..., 0x38
     stack_push(PC_);
-    PC_.set_val(rst_vectors.at(index));
+    regs().set(PC_, index * 0x08);
 }
 
 /* SBC */
 void CPU::opcode_sbc_a(const uint8_t subtrahend) {
-    uint8_t old_A_val = A_.get_val();
-    bool carry_flag = F_.get_carry_flag();
+    uint8_t old_A_val = regs().get(A_);
+    bool carry_flag = regs().F.get_carry_flag();
     int res = old_A_val - subtrahend - carry_flag;
 
-    A_.set_val(static_cast<uint8_t>(res));
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(((old_A_val & 0xF) - (subtrahend & 0xF) - carry_flag) < 0);
-    F_.set_carry_flag(res < 0);
+    regs().set(A_, static_cast<uint8_t>(res));
+    regs().F.set_sub(old_A_val, subtrahend, carry_flag);
 }
 
-void CPU::opcode_sbc(const ByteRegister& subtrahend) {
-    opcode_sbc_a(subtrahend.get_val());
+void CPU::opcode_sbc(Reg8 subtrahend) {
+    opcode_sbc_a(regs().get(subtrahend));
 } // r
 
 void CPU::opcode_sbc(const Address& subtrahend) {
@@ -564,116 +466,35 @@ void CPU::opcode_sbc(const Address& subtrahend) {
 } // (rr)
 
 void CPU::opcode_sbc() {
-    opcode_sbc_a(get_next_byte());
+    opcode_sbc_a(imm8());
 } // n
 
 /* SCF */
 void CPU::opcode_scf() {
-    F_.set_carry_flag(true);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-}
-
-/* SET */
-uint8_t CPU::_opcode_set(uint8_t bit_to_set, uint8_t val) {
-    // same as res but sets to 1 instead 0
-    uint8_t mask = 1 << bit_to_set;
-    uint8_t res = val | mask;
-    return res; 
-}
-
-void CPU::opcode_set(uint8_t bit_to_set, ByteRegister& reg) {
-    reg.set_val(_opcode_set(bit_to_set, reg.get_val()));
-}
-
-void CPU::opcode_set(uint8_t bit_to_set, Address& reg) {
-    gameboy.mmu.write(reg, _opcode_set(bit_to_set, gameboy.mmu.read(reg)));
-}
-
-
-/* SLA */
-uint8_t CPU::_opcode_sla(uint8_t val) {
-    uint8_t carry_flag = val & 0x80;
-    uint8_t res = val << 1;
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(carry_flag == 1);
-    return res;
-}
-
-void CPU::opcode_sla(ByteRegister& reg) {
-    reg.set_val(reg.get_val());
-}
-
-void CPU::opcode_sla(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_sla(gameboy.mmu.read(reg)));
-}
-
-
-/* SRA */
-uint8_t CPU::_opcode_sra(uint8_t val) {
-    uint8_t carry_flag = val & 0x01;
-    uint8_t msb = val & 0x80;
-    uint8_t res = (val >> 1) | (msb << 7);
-
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(carry_flag == 1);
-    return res;
-}
-
-void CPU::opcode_sra(ByteRegister& reg) {
-    reg.set_val(reg.get_val());
-}
-
-void CPU::opcode_sra(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_sra(gameboy.mmu.read(reg)));
-}
-
-
-
-/* SRL */
-uint8_t CPU::_opcode_srl(uint8_t val) {
-    uint8_t lsb = val & 0x01;
-    uint8_t res = val >> 1;
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(lsb == 1);
-    return res;
-}
-
-void CPU::opcode_srl(ByteRegister& reg) {
-    reg.set_val(_opcode_srl(reg.get_val()));
-}
-
-void CPU::opcode_srl(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_srl(gameboy.mmu.read(reg)));
+    regs().F.set_carry_flag(true);
+    regs().F.set_subtract_flag(false);
+    regs().F.set_half_carry_flag(false);
 }
 
 /* STOP */
 void CPU::opcode_stop() {
-    // TODO, halted=true? 
+    // like HALT, but only a button press ends it
+    machine_.cpu.halted = true;
+    machine_.cpu.stopped = true;
+    machine_.cpu.yield = true;
 }
 
 /* SUB */
 void CPU::opcode_sub_a(const uint8_t subtrahend) {
-    uint8_t old_A_val = A_.get_val();
+    uint8_t old_A_val = regs().get(A_);
     int res = old_A_val - subtrahend;
 
-    A_.set_val(static_cast<uint8_t>(res));
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(true);
-    F_.set_half_carry_flag(((old_A_val & 0xF) - (subtrahend & 0xF)) < 0);
-    F_.set_carry_flag(res < 0);
+    regs().set(A_, static_cast<uint8_t>(res));
+    regs().F.set_sub(old_A_val, subtrahend, false);
 }
 
-void CPU::opcode_sub(const ByteRegister& subtrahend) {
-    opcode_sub_a(subtrahend.get_val());
+void CPU::opcode_sub(Reg8 subtrahend) {
+    opcode_sub_a(regs().get(subtrahend));
 } // r
 
 void CPU::opcode_sub(const Address& subtrahend) {
@@ -681,40 +502,18 @@ void CPU::opcode_sub(const Address& subtrahend) {
 } // (rr)
 
 void CPU::opcode_sub() {
-    opcode_sub_a(get_next_byte());
+    opcode_sub_a(imm8());
 } // n
 
-/* SWAP */
-uint8_t CPU::_opcode_swap(uint8_t val) {
-    uint8_t res = ((val & 0xF0) >> 4) | ((val & 0x0F) << 4);
-    F_.set_zero_flag(res == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(false);
-    return res;
-}
-
-void CPU::opcode_swap(ByteRegister& reg) {
-    reg.set_val(_opcode_swap(reg.get_val()));
-}
-
-void CPU::opcode_swap(Address& reg) {
-    gameboy.mmu.write(reg, _opcode_swap(gameboy.mmu.read(reg)));
-}
-
 /* XOR */
 void CPU::opcode_xor_a(uint8_t val) {
-    uint8_t old_A_val = A_.get_val();
-    A_.set_val(old_A_val ^ val);
-
-    F_.set_zero_flag(A_.get_val() == 0);
-    F_.set_subtract_flag(false);
-    F_.set_half_carry_flag(false);
-    F_.set_carry_flag(false);
+    uint8_t old_A_val = regs().get(A_);
+    regs().set(A_, old_A_val ^ val);
+    regs().F.set_or(regs().get(A_));
 }
 
-void CPU::opcode_xor(const ByteRegister& reg) {
-    opcode_xor_a(reg.get_val());
+void CPU::opcode_xor(Reg8 reg) {
+    opcode_xor_a(regs().get(reg));
 } // r
 
 void CPU::opcode_xor(const Address& reg) {
@@ -722,5 +521,5 @@ void CPU::opcode_xor(const Address& reg) {
 } // (rr)
 
 void CPU::opcode_xor() {
-    opcode_xor_a(get_next_byte());
+    opcode_xor_a(imm8());
 } // n
\ No newline at end of file
@@ -2,83 +2,152 @@
 #define REGISTERS_H
 
 #include <cstdint>
+#include <type_traits>
 
-// General Register template
-template <typename T>
-class Register {
-    public:
-        Register() = default;
-        virtual ~Register() = default;
-        
-        virtual void set_val(T value) = 0;
-        virtual T get_val() const = 0;
-        virtual void increment() = 0;
-        virtual void decrement() = 0;
+// 8-bit register ids. Each value is the register's index in RegisterFile
+// storage; pairs are laid out low byte first (C, B / E, D / L, H) so a
+// pair read is two adjacent bytes.
+enum class Reg8 : uint8_t {
+    C = 0, B = 1,
+    E = 2, D = 3,
+    L = 4, H = 5,
+    A = 6
 };
 
-// 8-bit register
-class ByteRegister : public Register<uint8_t> {
-    public:
-        void set_val(uint8_t value) override;
-        uint8_t get_val() const override;
-        void increment() override;
-        void decrement() override;
-
-    protected:
-        uint8_t val_ = 0x0;
+// 16-bit register ids
+enum class Reg16 : uint8_t {
+    BC = 0,
+    DE = 1,
+    HL = 2,
+    AF = 3,
+    SP = 4,
+    PC = 5
 };
 
 // Flag register
 // Z, N, H, C, 0, 0, 0, 0
 // Z: Zero Flag, N: Subtract Flag, H: Half-Carry Flag, C: Carry Flag
-class FlagRegister : public ByteRegister {
+//
+// ALU opcodes hand their operands to set_add/set_sub/set_inc/... which
+// compute all four flags in one store. Deferring that work until a flag
+// is read (lazy flags, GB_LAZY_FLAGS) was tried and dropped: recording the
+// operands cost as much as it saved. On an ALU loop ROM in the interpreter
+// (median of 10 runs of 4000 frames) lazy gave 49.3 guest MIPS, eager
+// behind the same operand recording 49.6, and this store-only form 52.8.
+class FlagRegister {
     public:
-        void set_zero_flag(bool val);
-        void set_subtract_flag(bool val);
-        void set_half_carry_flag(bool val);
-        void set_carry_flag(bool val);
+        void set_val(uint8_t value) { val_ = value & 0xF0; }
+        uint8_t get_val() const { return val_; }
 
-        uint8_t get_zero_flag() const;
-        uint8_t get_subtract_flag() const;
-        uint8_t get_half_carry_flag() const;
-        uint8_t get_carry_flag() const;
+        void set_zero_flag(bool val) { set_bit(7, val); }
+        void set_subtract_flag(bool val) { set_bit(6, val); }
+        void set_half_carry_flag(bool val) { set_bit(5, val); }
+        void set_carry_flag(bool val) { set_bit(4, val); }
 
-    private:
-        
-};
+        uint8_t get_zero_flag() const { return (val_ >> 7) & 0x1; }
+        uint8_t get_subtract_flag() const { return (val_ >> 6) & 0x1; }
+        uint8_t get_half_carry_flag() const { return (val_ >> 5) & 0x1; }
+        uint8_t get_carry_flag() const { return (val_ >> 4) & 0x1; }
 
-// 16-bit register
-class WordRegister : public Register<uint16_t> {
-    public:
-        virtual void set_val(uint16_t value) override;
-        virtual uint16_t get_val() const override;
-        virtual void increment() override;
-        virtual void decrement() override;
-        virtual uint8_t high_byte() const;
-        virtual uint8_t low_byte() const;
+        // lhs + rhs + carry_in (ADD, ADC)
+        void set_add(uint8_t lhs, uint8_t rhs, bool carry_in) {
+            unsigned res = lhs + rhs + carry_in;
+            bool half = ((lhs & 0xF) + (rhs & 0xF) + carry_in) > 0xF;
+            val_ = flags((res & 0xFF) == 0, false, half, res > 0xFF);
+        }
+        // lhs - rhs - carry_in (SUB, SBC, CP)
+        void set_sub(uint8_t lhs, uint8_t rhs, bool carry_in) {
+            int res = lhs - rhs - carry_in;
+            bool half = ((lhs & 0xF) - (rhs & 0xF) - carry_in) < 0;
+            val_ = flags((res & 0xFF) == 0, true, half, res < 0);
+        }
+        // INC/DEC of old_val, carry is left untouched
+        void set_inc(uint8_t old_val) {
+            val_ = flags(old_val == 0xFF, false, (old_val & 0xF) == 0xF, false) | (val_ & 0x10);
+        }
+        void set_dec(uint8_t old_val) {
+            val_ = flags(old_val == 0x01, true, (old_val & 0xF) == 0x0, false) | (val_ & 0x10);
+        }
+        // result of AND (sets H) or OR/XOR
+        void set_and(uint8_t res) { val_ = flags(res == 0, false, true, false); }
+        void set_or(uint8_t res) { val_ = flags(res == 0, false, false, false); }
+        // result of a rotate, shift or SWAP and the bit shifted out
+        void set_shift(uint8_t res, bool carry) { val_ = flags(res == 0, false, false, carry); }
 
     private:
-        uint16_t val_ = 0x0;
+        void set_bit(uint8_t bit, bool val) { val_ = (val_ & ~(1 << bit)) | (val << bit); }
 
+        static uint8_t flags(bool zero, bool subtract, bool half_carry, bool carry) {
+            return (zero << 7) | (subtract << 6) | (half_carry << 5) | (carry << 4);
+        }
+
+        uint8_t val_ = 0x0;
 };
 
-// Pair of two 8-bit registers
-class PairRegister : public WordRegister {
+// Flat register file: A, B, C, D, E, H, L, F, SP and PC with 8-bit and
+// 16-bit views over the same storage. No virtual dispatch and no pointers,
+// so the whole file is trivially copyable and every accessor inlines down to
+// a load or store once the register id is a constant.
+class RegisterFile {
     public:
-        PairRegister() = delete;
-        PairRegister(ByteRegister& high_byte, ByteRegister& low_byte): high_byte_(high_byte), low_byte_(low_byte) {};
-        
-        void set_val(uint16_t value) override;
-        uint16_t get_val() const override;
-        void increment() override;
-        void decrement() override;
-        uint8_t high_byte() const override;
-        uint8_t low_byte() const override;
+        uint8_t get(Reg8 reg) const { return r8_[index(reg)]; }
+        void set(Reg8 reg, uint8_t value) { r8_[index(reg)] = value; }
+
+        uint16_t get(Reg16 reg) const {
+            switch (reg) {
+                case Reg16::AF: return (r8_[index(Reg8::A)] << 8) | F.get_val();
+                case Reg16::SP: return sp_;
+                case Reg16::PC: return pc_;
+                default: return (r8_[pair_index(reg) + 1] << 8) | r8_[pair_index(reg)];
+            }
+        }
+
+        void set(Reg16 reg, uint16_t value) {
+            switch (reg) {
+                case Reg16::AF:
+                    r8_[index(Reg8::A)] = value >> 8;
+                    F.set_val(value & 0xFF);
+                    break;
+                case Reg16::SP: sp_ = value; break;
+                case Reg16::PC: pc_ = value; break;
+                default:
+                    r8_[pair_index(reg)] = value & 0xFF;
+                    r8_[pair_index(reg) + 1] = value >> 8;
+                    break;
+            }
+        }
+
+        void increment(Reg16 reg) { set(reg, get(reg) + 1); }
+        void decrement(Reg16 reg) { set(reg, get(reg) - 1); }
+
+        FlagRegister F;
 
     private:
-        ByteRegister& high_byte_;
-        ByteRegister& low_byte_;
+        friend class Jit; // generated code addresses the storage directly
+
+        static constexpr uint8_t index(Reg8 reg) { return static_cast<uint8_t>(reg); }
+        static constexpr uint8_t pair_index(Reg16 reg) { return static_cast<uint8_t>(reg) * 2; }
+
+        uint8_t r8_[7] = {};
+        uint16_t sp_ = 0x0;
+        uint16_t pc_ = 0x0;
 };
 
+static_assert(std::is_trivially_copyable<RegisterFile>::value, "RegisterFile must stay memcpy-able");
+
+// CPU state that outlives an instruction, kept in the machine state arena
+struct CpuState {
+    RegisterFile regs;
+    bool ime = false;         // interrupt master enable
+    bool ime_pending = false; // EI: IME goes on after the next instruction
+    bool halted = false;      // HALT or STOP, woken by an interrupt request
+    bool stopped = false;     // STOP, only a joypad request wakes it
+    bool locked = false;      // executed an illegal opcode, the CPU stops for good
+    // Set by HALT, STOP, EI, RETI, illegal opcodes and writes to IE or IF,
+    // and after events that raise a request: the run loops return to
+    // run_until() to deal with it. The only check between instructions.
+    bool yield = false;
+    uint64_t retired = 0; // instructions executed by tick() and run_until()
+};
 
-#endif
\ No newline at end of file
+#endif
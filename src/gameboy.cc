@@ -0,0 +1,291 @@
+#include "gameboy.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <string>
+#include <utility>
+#include "cpu.h"
+
+namespace {
+
+StatePool& cpu_pool() {
+    static StatePool pool(sizeof(CPU));
+    return pool;
+}
+
+CPU* make_cpu(GameBoy& gameboy) {
+    void* slot = cpu_pool().acquire();
+    try {
+        return new (slot) CPU(gameboy);
+    } catch (...) {
+        cpu_pool().release(slot);
+        throw;
+    }
+}
+
+}
+
+void GameBoy::ReleaseCPU::operator()(CPU* cpu) const {
+    cpu->~CPU();
+    cpu_pool().release(cpu);
+}
+
+GameBoy::GameBoy():
+    cpu_(make_cpu(*this)),
+    mmu(cpu_->state()),
+    scheduler(cpu_->state().scheduler),
+    timer(cpu_->state(), mmu, scheduler),
+    ppu(cpu_->state(), mmu, scheduler),
+    apu(cpu_->state(), mmu),
+    cycles(cpu_->state().cycles)
+{
+    connect();
+}
+
+GameBoy::GameBoy(const GameBoy& other):
+    cpu_(make_cpu(*this)),
+    mmu(cpu_->state()),
+    scheduler(cpu_->state().scheduler),
+    timer(cpu_->state(), mmu, scheduler),
+    ppu(cpu_->state(), mmu, scheduler),
+    apu(cpu_->state(), mmu),
+    cycles(cpu_->state().cycles)
+{
+    copy_from(other);
+}
+
+GameBoy& GameBoy::operator=(const GameBoy& other) {
+    if (this != &other) {
+        copy_from(other);
+    }
+    return *this;
+}
+
+MachineState& GameBoy::state() {
+    return cpu_->state();
+}
+
+const MachineState& GameBoy::state() const {
+    return cpu_->state();
+}
+
+// Only the used part of the cartridge RAM is copied
+void GameBoy::copy_from(const GameBoy& other) {
+    std::memcpy(&state(), &other.state(), other.state().used_bytes(other.mmu.cartridge_ram_size()));
+    cartridge = other.cartridge;
+    mmu.copy_mapping(other.mmu);
+    cpu_->copy_state(*other.cpu_);
+    ppu.copy_output(other.ppu);
+    apu.copy_output(other.apu);
+    connect();
+}
+
+GameBoy::~GameBoy() = default;
+
+void GameBoy::connect() {
+    mmu.set_clock(&cycles);
+    cpu_->connect();
+    timer.connect();
+    ppu.connect();
+    apu.connect();
+}
+
+void GameBoy::load_cartridge(std::shared_ptr<const Cartridge> cart) {
+    cartridge = std::move(cart);
+    mmu.insert_cartridge(*cartridge);
+    cpu_->skip_boot_rom();
+    timer.skip_boot_rom();
+    ppu.skip_boot_rom();
+    apu.skip_boot_rom();
+}
+
+uint64_t GameBoy::run_frames(uint64_t n) {
+    uint64_t start = frame();
+    cpu_->run_until((start + n) * cycles_per_frame);
+    return frame() - start;
+}
+
+uint64_t GameBoy::run_cycles(uint64_t n) {
+    return cpu_->run_cycles(n);
+}
+
+uint64_t GameBoy::state_hash() const {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state());
+    std::size_t size = state().used_bytes(mmu.cartridge_ram_size());
+    uint64_t hash = 0xCBF29CE484222325;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001B3;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
+namespace {
+
+constexpr uint32_t machine_tag = state_tag("MACH");
+constexpr uint32_t cpu_tag = state_tag("CPU ");
+constexpr uint32_t memory_tag = state_tag("MEM ");
+constexpr uint32_t banking_tag = state_tag("MBC ");
+constexpr uint32_t scheduler_tag = state_tag("SCHD");
+constexpr uint32_t timer_tag = state_tag("TIMR");
+constexpr uint32_t ppu_tag = state_tag("PPU ");
+constexpr uint32_t apu_tag = state_tag("APU ");
+
+// Every section load_state() needs, in the order save_state() writes them
+constexpr uint32_t section_tags[] = {
+    machine_tag, cpu_tag, memory_tag, banking_tag, scheduler_tag, timer_tag, ppu_tag, apu_tag
+};
+constexpr std::size_t section_count = sizeof(section_tags) / sizeof(section_tags[0]);
+
+std::string section_name(uint32_t tag) {
+    std::string name;
+    for (int i = 0; i < 4; i++) {
+        name += static_cast<char>(tag >> (8 * i));
+    }
+    name.erase(name.find_last_not_of(' ') + 1);
+    return name;
+}
+
+// Throws unless payload is exactly what the component's save_state()
+// writes, so applying the sections afterwards cannot fail halfway
+void check_section(uint32_t tag, StateReader payload, std::size_t ram_size) {
+    constexpr std::size_t memory_bytes = sizeof(MachineState::memory) + sizeof(MachineState::high);
+    std::size_t length = payload.remaining();
+    bool valid = false;
+    switch (tag) {
+        case machine_tag: valid = length == 8; break;
+        case cpu_tag: valid = length == 24 || length == 25; break; // 24: written before STOP was saved
+        case memory_tag:
+            if (length >= memory_bytes + 4) {
+                payload.skip(memory_bytes);
+                if (payload.u32() != ram_size) {
+                    throw StateError("cartridge RAM size does not match the cartridge");
+                }
+                valid = payload.remaining() == ram_size;
+            }
+            break;
+        case banking_tag: valid = length == 24; break;
+        case scheduler_tag: valid = length >= 1 && length == 1 + 8 * std::size_t(payload.u8()); break;
+        case timer_tag: valid = length == 16; break;
+        case ppu_tag: valid = length == 20; break;
+        case apu_tag: valid = length == 71; break;
+        default: break;
+    }
+    if (!valid) {
+        throw StateError(section_name(tag) + " section has the wrong length");
+    }
+}
+
+}
+
+// Generous bound: everything but memory is well under 1 KiB
+std::size_t GameBoy::state_size() const {
+    std::size_t ram = cartridge ? cartridge->header().ram_size : 0;
+    return state_header_size + 0x10000 + ram + 1024;
+}
+
+std::size_t GameBoy::save_state(std::vector<uint8_t>& out) const {
+    if (out.size() < state_size()) {
+        out.resize(state_size());
+    }
+    // shrinking keeps the capacity, so the next save still fits
+    out.resize(save_state(out.data(), out.size()));
+    return out.size();
+}
+
+std::size_t GameBoy::save_state(uint8_t* buffer, std::size_t capacity) const {
+    StateWriter out(buffer, capacity);
+    out.bytes("GBST", 4);
+    out.u16(state_version);
+    out.u8(cartridge ? cartridge->header().header_checksum : 0);
+    out.u16(cartridge ? cartridge->header().global_checksum : 0);
+
+    out.begin_section(machine_tag);
+    out.u64(cycles);
+    out.end_section();
+
+    out.begin_section(cpu_tag);
+    cpu_->save_state(out);
+    out.end_section();
+
+    out.begin_section(memory_tag);
+    mmu.save_memory(out);
+    out.end_section();
+
+    out.begin_section(banking_tag);
+    mmu.save_banking(out);
+    out.end_section();
+
+    out.begin_section(scheduler_tag);
+    scheduler.save_state(out);
+    out.end_section();
+
+    out.begin_section(timer_tag);
+    timer.save_state(out);
+    out.end_section();
+
+    out.begin_section(ppu_tag);
+    ppu.save_state(out);
+    out.end_section();
+
+    out.begin_section(apu_tag);
+    apu.save_state(out);
+    out.end_section();
+    return out.size();
+}
+
+void GameBoy::load_state(const uint8_t* data, std::size_t size) {
+    StateReader in(data, size);
+    char magic[4];
+    in.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, "GBST", 4) != 0) {
+        throw StateError("not a save state");
+    }
+    if (in.u16() > state_version) {
+        throw StateError("save state is from a newer version");
+    }
+    uint8_t header_checksum = in.u8();
+    uint16_t global_checksum = in.u16();
+    if (cartridge && (header_checksum != cartridge->header().header_checksum ||
+                      global_checksum != cartridge->header().global_checksum)) {
+        throw StateError("save state belongs to a different cartridge");
+    }
+
+    // check every section before changing anything, so a state that is
+    // rejected leaves the machine as it was
+    StateReader payloads[section_count];
+    bool found[section_count] = {};
+    uint32_t tag;
+    StateReader payload;
+    while (in.next_section(tag, payload)) {
+        const uint32_t* known = std::find(std::begin(section_tags), std::end(section_tags), tag);
+        if (known == std::end(section_tags)) {
+            continue; // written by a newer build, skip
+        }
+        check_section(tag, payload, mmu.cartridge_ram_size());
+        std::size_t index = static_cast<std::size_t>(known - std::begin(section_tags));
+        payloads[index] = payload;
+        found[index] = true;
+    }
+    for (std::size_t i = 0; i < section_count; i++) {
+        if (!found[i]) {
+            throw StateError("save state has no " + section_name(section_tags[i]) + " section");
+        }
+    }
+
+    cycles = payloads[0].u64();
+    cpu_->load_state(payloads[1]);
+    mmu.load_memory(payloads[2]);
+    mmu.load_banking(payloads[3]);
+    scheduler.load_state(payloads[4]);
+    timer.load_state(payloads[5]);
+    ppu.load_state(payloads[6]);
+    apu.load_state(payloads[7]);
+}
@@ -1,12 +1,128 @@
 #ifndef GAMEBOY_H
 #define GAMEBOY_H
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "apu.h"
+#include "cartridge.h"
+#include "machine_state.h"
 #include "mmu.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "state.h"
+#include "timer.h"
 
+class CPU;
+
+/* Machine
+ * Owns every component. The headless entry points (run_frames, run_cycles)
+ * run the CPU flat out with no rendering or real-time pacing; time only
+ * exists as the M-cycle counter.
+ *
+ * All mutable state sits in one MachineState arena embedded in the CPU,
+ * which comes from a shared StatePool; the other components are views
+ * onto the arena plus per-machine wiring.
+ */
 class GameBoy {
+    private:
+        struct ReleaseCPU {
+            void operator()(CPU* cpu) const;
+        };
+
+        // Declared first: it holds the arena every component below points into
+        std::unique_ptr<CPU, ReleaseCPU> cpu_;
+
     public:
+        // 154 lines of 114 M-cycles
+        static constexpr uint64_t cycles_per_frame = 17556;
+
+        GameBoy();
+        ~GameBoy();
+
+        /* Copies
+         * A copy is an independent machine in the same state. The cartridge
+         * ROM is shared, the arena is copied in one block and the CPU is
+         * rebound to the new machine. Assigning into an existing machine
+         * reuses its arena, so a pool of machines can be re-forked from a
+         * state without allocating.
+         */
+        GameBoy(const GameBoy& other);
+        GameBoy& operator=(const GameBoy& other);
+        std::unique_ptr<GameBoy> clone() const { return std::make_unique<GameBoy>(*this); }
+
+        // Inserts the cartridge and puts the CPU and LCD in the state the
+        // boot ROM leaves them in, with PC at 0x0100
+        void load_cartridge(std::shared_ptr<const Cartridge> cart);
+
+        // Runs to the end of the n-th frame boundary from now, returns the
+        // number of frames completed
+        uint64_t run_frames(uint64_t n);
+        uint64_t run_cycles(uint64_t n);
+
+        uint64_t frame() const { return cycles / cycles_per_frame; }
+
+        // Draws one frame in every interval (1 by default, 0 for none) for
+        // runs that only need memory; skipped frames behave the same in
+        // every way the game can observe. See PPU::render_stats().
+        void set_render_interval(unsigned interval) { ppu.set_render_interval(interval); }
+
+        // Without audio the APU only keeps NR52 status and the counters that
+        // drive it; see APU
+        void set_audio_enabled(bool enabled) { apu.set_enabled(enabled); }
+
+        // Output that lives outside the arena (the APU's sample buffers),
+        // set aside and put back by callers that roll the arena back and run
+        // the same cycles again (CPU::run_native's differential check).
+        // Every component with host-side output it generates while running
+        // belongs here.
+        void hold_output() { apu.hold_output(); }
+        void restore_output() { apu.restore_output(); }
+
+        CPU& cpu() { return *cpu_; }
+
+        MachineState& state();
+        const MachineState& state() const;
+
+        // Hash of the raw arena: equal machines hash equal. Two machines that
+        // reached the same state by different paths can still differ in
+        // bytes no instruction reads back (e.g. struct padding).
+        uint64_t state_hash() const;
+
+        /* Save states, see state.h for the format
+         * save_state() resizes out to the state's size; reusing one buffer
+         * only allocates on the first save. load_state() throws StateError
+         * for a foreign, newer, damaged or incomplete state; the ROM
+         * identity and every section's length are checked before anything
+         * is touched, so a rejected state leaves the machine unchanged.
+         */
+        std::size_t state_size() const;
+        std::size_t save_state(std::vector<uint8_t>& out) const;
+        std::size_t save_state(uint8_t* buffer, std::size_t capacity) const;
+        void load_state(const uint8_t* data, std::size_t size);
+        void load_state(const std::vector<uint8_t>& state) { load_state(state.data(), state.size()); }
+
         MMU mmu;
-    
+
+        // Shared between every machine running the same ROM
+        std::shared_ptr<const Cartridge> cartridge;
+
+        Scheduler scheduler;
+
+        Timer timer;
+
+        PPU ppu;
+
+        APU apu;
+
+        // M-cycles (1.048576 MHz) since power on
+        uint64_t& cycles; // in the arena
+
+    private:
+        // Points components at the machine's clock and registers their I/O
+        // and event handlers, which copies must redo for themselves
+        void connect();
+        void copy_from(const GameBoy& other);
 };
 
-#endif
\ No newline at end of file
+#endif
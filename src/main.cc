@@ -1,5 +1,260 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-int main() {
-    std::cout << "hello world" << std::endl;
+#include <string>
+#include "cartridge.h"
+#include "cpu.h"
+#include "gameboy.h"
+#include "ppu.h"
+#include "runner.h"
+
+namespace {
+
+void usage(const char* argv0) {
+    std::cerr << "usage: " << argv0 << " <rom> [--frames N | --cycles N] [--blocks] [--render-every N] [--no-audio]"
+              << " [--no-idle-skip] [--tile-cache]"
+              << " [--instances N [--threads N]]"
+#ifdef GB_JIT
+              << " [--jit]"
+#endif
+              << "\n"
+              << "       " << argv0 << " --bench-ppu [--frames N]\n"
+              << "Runs the ROM headless as fast as possible and reports speed at exit.\n"
+              << "With --instances, runs N copies across a work-stealing thread pool.\n"
+              << "--render-every N draws one frame in N (0: none) and reports the host time saved.\n"
+              << "--no-audio keeps only the sound state games can read back.\n"
+              << "--tile-cache draws from pre-decoded tiles (off by default, see --bench-ppu).\n"
+              << "--no-idle-skip runs every pass of polling loops (skipped with --blocks or --jit).\n"
+              << "--bench-ppu renders N frames of random tiles and sprites with each tile decoder,\n"
+              << "decoding as it draws and through the tile cache.\n";
+}
+
+// Scanline rendering throughput of each tile decoder with and without the
+// tile cache, on a screen with background, window and ten sprites on most
+// lines. VRAM does not change, so the cache is decoded once.
+int bench_ppu(uint64_t frames) {
+    GameBoy gameboy;
+    MachineState& state = gameboy.state();
+    uint32_t seed = 0x12345678;
+    auto random = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+    for (uint16_t address = 0x8000; address < 0xA000; address++) {
+        state.memory[address] = static_cast<uint8_t>(random());
+    }
+    for (int i = 0; i < 40; i++) {
+        uint8_t* sprite = state.memory + 0xFE00 + i * 4;
+        sprite[0] = static_cast<uint8_t>(16 + (i % 18) * 8);
+        sprite[1] = static_cast<uint8_t>(random() % 168);
+        sprite[2] = static_cast<uint8_t>(random());
+        sprite[3] = static_cast<uint8_t>(random() & 0xF0);
+    }
+    uint8_t* high = state.high;
+    high[io::LCDC] = 0x73; // window, 0x8000 tiles, sprites, background (LCD left off)
+    high[io::SCY] = 5;
+    high[io::SCX] = 3;
+    high[io::BGP] = 0xE4;
+    high[io::OBP0] = 0xD2;
+    high[io::OBP1] = 0x1B;
+    high[io::WY] = 72;
+    high[io::WX] = 87;
+
+    std::cout << std::fixed << std::setprecision(1);
+    uint64_t reference = 0;
+    for (int run = 0; run < 6; run++) {
+        TileDecoder decoder = static_cast<TileDecoder>(run / 2);
+        bool cached = run % 2;
+        std::string name = std::string(tile_decoder_name(decoder)) + (cached ? " cached" : "");
+        if (!tile_decoder_available(decoder)) {
+            if (!cached) {
+                std::cout << std::setw(14) << std::left << tile_decoder_name(decoder) << "not built in\n";
+            }
+            continue;
+        }
+        gameboy.ppu.set_tile_decoder(decoder);
+        gameboy.ppu.set_tile_cache_enabled(cached);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t frame = 0; frame < frames; frame++) {
+            state.ppu.window_line = 0;
+            for (int ly = 0; ly < PPU::height; ly++) {
+                gameboy.ppu.render_line(static_cast<uint8_t>(ly));
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t checksum = 0;
+        for (int i = 0; i < PPU::width * PPU::height; i++) {
+            checksum = checksum * 31 + gameboy.ppu.framebuffer()[i];
+        }
+        if (!reference) {
+            reference = checksum;
+        }
+        double pixels = static_cast<double>(frames) * PPU::width * PPU::height;
+        std::cout << std::setw(14) << std::left << name
+                  << pixels / seconds / 1e6 << " Mpixels/sec, "
+                  << seconds * 1e9 / (frames * PPU::height) << " ns/line"
+                  << (checksum == reference ? "" : "  (output differs from scalar)") << "\n";
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// Per-instance and aggregate throughput of a multi-instance run
+int run_instances(std::shared_ptr<const Cartridge> cartridge, uint64_t instances, unsigned threads,
+                  uint64_t frames, bool blocks, bool jit, unsigned render_interval, bool audio,
+                  bool idle_skip, bool tile_cache) {
+    Runner runner(threads);
+    for (uint64_t i = 0; i < instances; i++) {
+        runner.add_instance(cartridge, [blocks, jit, render_interval, audio, idle_skip, tile_cache](GameBoy& gameboy) {
+            gameboy.set_render_interval(render_interval);
+            gameboy.ppu.set_tile_cache_enabled(tile_cache);
+            gameboy.set_audio_enabled(audio);
+            gameboy.cpu().set_block_cache_enabled(blocks);
+            gameboy.cpu().set_idle_skip_enabled(idle_skip);
+#ifdef GB_JIT
+            gameboy.cpu().set_jit_enabled(jit);
+#endif
+        });
+    }
+    RunnerStats total = runner.run_frames(frames);
+    double seconds = total.wall_ns / 1e9;
+
+    std::cout << std::fixed << std::setprecision(1);
+    for (std::size_t i = 0; i < runner.instances(); i++) {
+        const InstanceStats& stats = runner.stats(i);
+        double busy = stats.busy_ns / 1e9;
+        std::cout << "instance " << i << ": " << stats.frames << " frames, "
+                  << stats.frames / busy << " frames/sec, "
+                  << stats.instructions / busy / 1e6 << " MIPS, "
+                  << stats.steals << "/" << stats.slices << " slices stolen\n";
+    }
+    std::cout << "threads:       " << total.threads << "\n"
+              << "frames:        " << total.frames << "\n"
+              << "wall time:     " << seconds * 1e3 << " ms\n"
+              << "frames/sec:    " << total.frames / seconds << "\n"
+              << "guest MIPS:    " << total.instructions / seconds / 1e6 << "\n"
+              << "host ns/frame: " << seconds * 1e9 / total.frames << " (wall / all frames)\n";
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string rom_path;
+    uint64_t frames = 600;
+    uint64_t cycles = 0;
+    uint64_t instances = 0;
+    uint64_t threads = 0;
+    uint64_t render_interval = 1;
+    bool blocks = false;
+    bool jit = false;
+    bool bench = false;
+    bool audio = true;
+    bool idle_skip = true;
+    bool tile_cache = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        bool numeric = !std::strcmp(argv[i], "--frames") || !std::strcmp(argv[i], "--cycles") ||
+                       !std::strcmp(argv[i], "--instances") || !std::strcmp(argv[i], "--threads") ||
+                       !std::strcmp(argv[i], "--render-every");
+        if (numeric && has_value) {
+            uint64_t& value = argv[i][2] == 'f' ? frames : argv[i][2] == 'c' ? cycles :
+                              argv[i][2] == 'i' ? instances : argv[i][2] == 'r' ? render_interval : threads;
+            char* end = nullptr;
+            value = std::strtoull(argv[++i], &end, 10);
+            if (*end != '\0') {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (!std::strcmp(argv[i], "--blocks")) {
+            blocks = true;
+        } else if (!std::strcmp(argv[i], "--jit")) {
+            jit = true;
+        } else if (!std::strcmp(argv[i], "--no-audio")) {
+            audio = false;
+        } else if (!std::strcmp(argv[i], "--no-idle-skip")) {
+            idle_skip = false;
+        } else if (!std::strcmp(argv[i], "--tile-cache")) {
+            tile_cache = true;
+        } else if (!std::strcmp(argv[i], "--bench-ppu")) {
+            bench = true;
+        } else if (argv[i][0] != '-' && rom_path.empty()) {
+            rom_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (bench) {
+        return bench_ppu(frames);
+    }
+    if (rom_path.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::shared_ptr<const Cartridge> cartridge;
+    try {
+        cartridge = Cartridge::load(rom_path);
+    } catch (const CartridgeError& e) {
+        std::cerr << rom_path << ": " << e.what() << "\n";
+        return 1;
+    }
+    if (instances) {
+        return run_instances(cartridge, instances, threads, frames, blocks, jit,
+                             static_cast<unsigned>(render_interval), audio, idle_skip, tile_cache);
+    }
+
+    GameBoy gameboy;
+    gameboy.load_cartridge(cartridge);
+    gameboy.set_render_interval(static_cast<unsigned>(render_interval));
+    gameboy.set_audio_enabled(audio);
+    gameboy.ppu.set_tile_cache_enabled(tile_cache);
+    gameboy.cpu().set_block_cache_enabled(blocks);
+    gameboy.cpu().set_idle_skip_enabled(idle_skip);
+#ifdef GB_JIT
+    gameboy.cpu().set_jit_enabled(jit);
+#else
+    if (jit) {
+        std::cerr << "built without GB_JIT, running without the JIT\n";
+    }
+#endif
+
+    auto start = std::chrono::steady_clock::now();
+    if (cycles) {
+        gameboy.run_cycles(cycles);
+    } else {
+        gameboy.run_frames(frames);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double emulated_frames = static_cast<double>(gameboy.cycles) / GameBoy::cycles_per_frame;
+    uint64_t instructions = gameboy.cpu().instructions_retired();
+    std::cout << std::fixed << std::setprecision(1)
+              << "frames:        " << emulated_frames << "\n"
+              << "instructions:  " << instructions << "\n"
+              << "host time:     " << seconds * 1e3 << " ms\n"
+              << "frames/sec:    " << emulated_frames / seconds << " ("
+              << emulated_frames / seconds / 59.7275 << "x real time)\n"
+              << "guest MIPS:    " << instructions / seconds / 1e6 << "\n"
+              << "host ns/frame: " << seconds * 1e9 / emulated_frames << "\n";
+
+    const RenderStats& render = gameboy.ppu.render_stats();
+    std::cout << "drawn/skipped: " << render.frames_drawn << "/" << render.frames_skipped << " frames\n";
+    if (render.timed_lines) {
+        std::cout << "render/frame:  " << render.ns_per_frame() << " ns (sampled)\n"
+                  << "render saved:  " << render.saved_ns() / 1e6 << " ms\n";
+    }
+    const IdleStats& idle = gameboy.cpu().idle_stats();
+    if (idle.skips) {
+        std::cout << "idle skipped:  " << idle.skipped_cycles << " cycles ("
+                  << 100.0 * idle.skipped_cycles / gameboy.cycles << "%) in " << idle.skips << " skips\n";
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef IO_REGISTERS_H
+#define IO_REGISTERS_H
+
+#include <cstdint>
+
+// Offsets of the I/O registers in 0xFF00-0xFFFF (MachineState::high)
+namespace io {
+
+constexpr uint8_t DIV = 0x04;   // divider, upper byte of the system counter
+constexpr uint8_t TIMA = 0x05;  // timer counter
+constexpr uint8_t TMA = 0x06;   // timer reload value
+constexpr uint8_t TAC = 0x07;   // timer enable and rate
+constexpr uint8_t IF = 0x0F;    // interrupt request flags
+
+constexpr uint8_t NR10 = 0x10;  // sound channel 1: sweep, duty/length, envelope, frequency
+constexpr uint8_t NR11 = 0x11;
+constexpr uint8_t NR12 = 0x12;
+constexpr uint8_t NR13 = 0x13;
+constexpr uint8_t NR14 = 0x14;
+constexpr uint8_t NR21 = 0x16;  // channel 2: pulse without sweep
+constexpr uint8_t NR22 = 0x17;
+constexpr uint8_t NR23 = 0x18;
+constexpr uint8_t NR24 = 0x19;
+constexpr uint8_t NR30 = 0x1A;  // channel 3: wave
+constexpr uint8_t NR31 = 0x1B;
+constexpr uint8_t NR32 = 0x1C;
+constexpr uint8_t NR33 = 0x1D;
+constexpr uint8_t NR34 = 0x1E;
+constexpr uint8_t NR41 = 0x20;  // channel 4: noise
+constexpr uint8_t NR42 = 0x21;
+constexpr uint8_t NR43 = 0x22;
+constexpr uint8_t NR44 = 0x23;
+constexpr uint8_t NR50 = 0x24;  // master volume
+constexpr uint8_t NR51 = 0x25;  // panning
+constexpr uint8_t NR52 = 0x26;  // power and channel status
+constexpr uint8_t WAVE = 0x30;  // 16 bytes of wave RAM
+
+constexpr uint8_t LCDC = 0x40;
+constexpr uint8_t STAT = 0x41;
+constexpr uint8_t SCY = 0x42;
+constexpr uint8_t SCX = 0x43;
+constexpr uint8_t LY = 0x44;
+constexpr uint8_t LYC = 0x45;
+constexpr uint8_t DMA = 0x46;
+constexpr uint8_t BGP = 0x47;
+constexpr uint8_t OBP0 = 0x48;
+constexpr uint8_t OBP1 = 0x49;
+constexpr uint8_t WY = 0x4A;
+constexpr uint8_t WX = 0x4B;
+
+constexpr uint8_t IE = 0xFF;    // interrupt enable
+
+}
+
+// Bits of IF and IE
+namespace interrupt {
+
+constexpr uint8_t vblank = 0x01;
+constexpr uint8_t stat = 0x02;
+constexpr uint8_t timer = 0x04;
+constexpr uint8_t serial = 0x08;
+constexpr uint8_t joypad = 0x10;
+
+}
+
+#endif
@@ -1,13 +1,258 @@
 #include "mmu.h"
+#include <algorithm>
 
-MMU::MMU() {
-    ram_ = std::vector<uint8_t>(0xFFFF);
+MMU::MMU(MachineState& state):
+    state_(state)
+{
+    // Until a cartridge is inserted the whole map is plain memory
+    map_plain_memory();
 }
 
-uint8_t MMU::read(const Address& location) {
-    return ram_.at(location.get_address());
+void MMU::map_plain_memory() {
+    map_pages(0x00, 0xC0, state_.memory, state_.memory);
+    map_pages(0xC0, 0x20, state_.memory + 0xC000, state_.memory + 0xC000);
+    map_pages(0xE0, 0x1E, state_.memory + 0xC000, state_.memory + 0xC000); // echo RAM
+    map_pages(0xFE, 0x02, nullptr, nullptr);
 }
 
-void MMU::write(const Address& location, uint8_t value) {
-    ram_.at(location.get_address()) = value;
-}
\ No newline at end of file
+// Page pointers into other's arena are rebased onto this MMU's arena
+void MMU::copy_mapping(const MMU& other) {
+    if (this == &other) {
+        return;
+    }
+    cartridge_ = other.cartridge_;
+    cartridge_ram_size_ = other.cartridge_ram_size_;
+    bank_stats_ = other.bank_stats_;
+
+    // pointers into the shared ROM mapping stay as they are
+    auto rebase = [&](auto* page) -> decltype(page) {
+        auto* other_state = reinterpret_cast<const uint8_t*>(&other.state_);
+        auto* state = reinterpret_cast<uint8_t*>(&state_);
+        if (page >= other_state && page < other_state + sizeof(MachineState)) {
+            return reinterpret_cast<decltype(page)>(state + (page - other_state));
+        }
+        return page;
+    };
+    for (int page = 0; page < 256; page++) {
+        read_pages_[page] = rebase(other.read_pages_[page]);
+        write_pages_[page] = rebase(other.write_pages_[page]);
+        mapped_write_pages_[page] = rebase(other.mapped_write_pages_[page]);
+        watched_pages_[page] = other.watched_pages_[page];
+        generation_[page] = other.generation_[page];
+    }
+}
+
+void MMU::insert_cartridge(const Cartridge& cartridge) {
+    cartridge_ = &cartridge;
+    state_.mbc = BankController(cartridge.header(), cartridge.rom_banks());
+    cartridge_ram_size_ = cartridge.header().ram_size;
+    std::fill(state_.cartridge_ram, state_.cartridge_ram + cartridge_ram_size_, 0xFF);
+    map_cartridge();
+}
+
+void MMU::map_cartridge() {
+    const uint8_t* low = cartridge_->rom_bank(state_.mbc.low_rom_bank());
+    const uint8_t* high = cartridge_->rom_bank(state_.mbc.high_rom_bank());
+    if (read_pages_[0x00] != low || read_pages_[0x40] != high) {
+        bank_stats_.rom_switches++;
+    }
+    map_pages(0x00, 0x40, low, nullptr);
+    map_pages(0x40, 0x40, high, nullptr);
+    state_.rom_bank = state_.mbc.high_rom_bank();
+
+    const uint8_t* old_ram = read_pages_[0xA0];
+    if (state_.mbc.ram_mapping() != BankController::RamMapping::Ram) {
+        // MBC2 RAM, the clock registers and disabled RAM go through the slow path
+        map_pages(0xA0, 0x20, nullptr, nullptr);
+    } else {
+        std::size_t bank_offset = state_.mbc.ram_bank() * 0x2000;
+        for (int page = 0; page < 0x20; page++) {
+            // RAM smaller than 8 KiB repeats over the area
+            uint8_t* ram = state_.cartridge_ram + (bank_offset + page * 0x100) % cartridge_ram_size_;
+            map_pages(0xA0 + page, 1, ram, ram);
+        }
+    }
+    if (read_pages_[0xA0] != old_ram) {
+        bank_stats_.ram_switches++;
+    }
+}
+
+uint8_t MMU::read_cartridge_ram(uint16_t address) {
+    switch (state_.mbc.ram_mapping()) {
+        case BankController::RamMapping::MBC2Ram: return 0xF0 | state_.cartridge_ram[address & 0x1FF];
+        case BankController::RamMapping::Rtc: return state_.mbc.read_rtc();
+        default: return 0xFF;
+    }
+}
+
+void MMU::write_cartridge_ram(uint16_t address, uint8_t value) {
+    switch (state_.mbc.ram_mapping()) {
+        case BankController::RamMapping::MBC2Ram: state_.cartridge_ram[address & 0x1FF] = value & 0x0F; break;
+        case BankController::RamMapping::Rtc: state_.mbc.write_rtc(value, now()); break;
+        default: break;
+    }
+}
+
+void MMU::map_pages(uint8_t first_page, int count, const uint8_t* read, uint8_t* write) {
+    for (int i = 0; i < count; i++) {
+        uint8_t page = first_page + i;
+        const uint8_t* page_read = read ? read + i * 0x100 : nullptr;
+        // blocks outside 0x4000-0x7FFF are not keyed by bank, so code decoded
+        // from the old mapping goes stale
+        bool banked = page >= 0x40 && page < 0x80;
+        if (watched_pages_[page] && !banked && read_pages_[page] != page_read) {
+            watched_pages_[page] = false;
+            generation_[page]++;
+        }
+        read_pages_[page] = page_read;
+        mapped_write_pages_[page] = write ? write + i * 0x100 : nullptr;
+        write_pages_[page] = watched_pages_[page] ? nullptr : mapped_write_pages_[page];
+    }
+}
+
+void MMU::map_io(uint16_t address, IoRead read, IoWrite write, void* context, IoStable stable) {
+    io_[address & 0xFF] = IoHandler{read, write, context, stable};
+}
+
+uint64_t MMU::stable_until(uint16_t address, uint64_t now) const {
+    if (address < 0xFF00) {
+        return UINT64_MAX; // memory, cartridge RAM and latched RTC only change on writes
+    }
+    const IoHandler& io = io_[address & 0xFF];
+    if (!io.read) {
+        return UINT64_MAX;
+    }
+    return io.stable ? io.stable(io.context, address, now) : now;
+}
+
+uint8_t MMU::echo_page(uint8_t page) {
+    if (page >= 0xC0 && page < 0xDE) {
+        return page + 0x20;
+    }
+    if (page >= 0xE0 && page < 0xFE) {
+        return page - 0x20;
+    }
+    return page;
+}
+
+void MMU::watch_page(uint16_t address) {
+    uint8_t page = address >> 8;
+    watched_pages_[page] = true;
+    write_pages_[page] = nullptr;
+    write_pages_[echo_page(page)] = nullptr;
+}
+
+uint8_t MMU::read_slow(uint16_t address) {
+    if (cartridge_ && address >= 0xA000 && address < 0xC000) {
+        return read_cartridge_ram(address);
+    }
+    if (address >= 0xFF00) {
+        const IoHandler& io = io_[address & 0xFF];
+        if (io.read) {
+            return io.read(io.context, address);
+        }
+        return state_.high[address & 0xFF];
+    }
+    if (address >= 0xFEA0) {
+        return 0x00; // unusable
+    }
+    return state_.memory[address];
+}
+
+void MMU::write_slow(uint16_t address, uint8_t value) {
+    uint8_t page = address >> 8;
+    if (mapped_write_pages_[page]) {
+        invalidate_page(page);
+        mapped_write_pages_[page][address & 0xFF] = value;
+        return;
+    }
+
+    if (address < 0x8000) {
+        if (cartridge_) {
+            bank_stats_.select_writes++;
+            if (state_.mbc.write_register(address, value, now())) {
+                map_cartridge();
+            }
+        }
+        return;
+    }
+    if (cartridge_ && address >= 0xA000 && address < 0xC000) {
+        write_cartridge_ram(address, value);
+        return;
+    }
+    if (address >= 0xFF00) {
+        const IoHandler& io = io_[address & 0xFF];
+        if (io.write) {
+            io.write(io.context, address, value);
+        } else {
+            invalidate_page(page); // HRAM holds code too
+            state_.high[address & 0xFF] = value;
+        }
+        return;
+    }
+    if (address >= 0xFEA0) {
+        return; // unusable
+    }
+    invalidate_page(page);
+    state_.memory[address] = value;
+}
+
+// A store is about to change page, so anything decoded from it (or from its
+// echo alias) is stale
+void MMU::invalidate_page(uint8_t page) {
+    uint8_t watched = watched_pages_[page] ? page : echo_page(page);
+    if (!watched_pages_[watched]) {
+        return;
+    }
+    watched_pages_[watched] = false;
+    generation_[watched]++;
+    write_pages_[watched] = mapped_write_pages_[watched];
+    uint8_t alias = echo_page(watched);
+    if (!watched_pages_[alias]) {
+        write_pages_[alias] = mapped_write_pages_[alias];
+    }
+}
+
+// 0x0000-0xFFFF as one 64 KiB block, then the cartridge RAM
+void MMU::save_memory(StateWriter& out) const {
+    out.bytes(state_.memory, sizeof(state_.memory));
+    out.bytes(state_.high, sizeof(state_.high));
+    out.u32(static_cast<uint32_t>(cartridge_ram_size_));
+    out.bytes(state_.cartridge_ram, cartridge_ram_size_);
+}
+
+void MMU::load_memory(StateReader& in) {
+    if (in.remaining() < sizeof(state_.memory) + sizeof(state_.high) + 4) {
+        throw StateError("memory section is truncated");
+    }
+    in.bytes(state_.memory, sizeof(state_.memory));
+    in.bytes(state_.high, sizeof(state_.high));
+    if (in.u32() != cartridge_ram_size_) {
+        throw StateError("cartridge RAM size does not match the cartridge");
+    }
+    in.bytes(state_.cartridge_ram, cartridge_ram_size_);
+    invalidate_all_pages();
+}
+
+void MMU::load_banking(StateReader& in) {
+    state_.mbc.load_state(in);
+    if (cartridge_) {
+        map_cartridge();
+    }
+    invalidate_all_pages();
+}
+
+void MMU::remap() {
+    if (cartridge_) {
+        map_cartridge();
+    } else {
+        map_plain_memory();
+    }
+    invalidate_all_pages();
+}
+
+void MMU::invalidate_all_pages() {
+    for (int page = 0; page < 256; page++) {
+        invalidate_page(page);
+    }
+}
@@ -1,17 +1,162 @@
 #ifndef MMU_H
 #define MMU_H
 
-#include <vector>
+#include <cstddef>
 #include <cstdint>
 #include "address.h"
+#include "bank_controller.h"
+#include "cartridge.h"
+#include "machine_state.h"
+#include "state.h"
 
+/* Memory map
+ * The 64 KiB address space is split into 256-byte pages. Each page has a
+ * host pointer for reads and one for writes; plain ROM/RAM pages point
+ * straight into the machine state arena (or the cartridge's ROM mapping)
+ * so a load or store is one table lookup and one
+ * access. A null pointer sends the access to the slow path, which handles
+ * OAM and the unusable area (0xFE00-0xFEFF), I/O registers, HRAM and IE
+ * (0xFF00-0xFFFF) and writes to pages the block cache is watching.
+ *
+ * Echo RAM (0xE000-0xFDFF) maps onto the same host memory as
+ * 0xC000-0xDDFF. With a cartridge inserted, ROM writes go to its bank
+ * controller and a bank switch re-points the 0x0000-0x7FFF and
+ * 0xA000-0xBFFF pages (map_cartridge()), so banked reads cost the same as
+ * any other read.
+ */
 class MMU {
     public:
-        MMU();
-        uint8_t read(const Address& location);
-        void write(const Address& location, uint8_t value);
+        // Memory, cartridge RAM and bank controller live in state
+        explicit MMU(MachineState& state);
+        MMU(const MMU&) = delete;
+        MMU& operator=(const MMU&) = delete;
+
+        // Takes over other's page tables, write tracking and cartridge,
+        // rebased onto this MMU's arena. Used after the arena itself was
+        // copied; I/O handlers are left alone, their owner re-registers them.
+        void copy_mapping(const MMU& other);
+
+        uint8_t read(const Address& location) {
+            uint16_t address = location.get_address();
+            const uint8_t* page = read_pages_[address >> 8];
+            return page ? page[address & 0xFF] : read_slow(address);
+        }
+
+        void write(const Address& location, uint8_t value) {
+            uint16_t address = location.get_address();
+            uint8_t* page = write_pages_[address >> 8];
+            if (page) {
+                page[address & 0xFF] = value;
+            } else {
+                write_slow(address, value);
+            }
+        }
+
+        // Maps the cartridge's ROM at 0x0000-0x7FFF without copying it and
+        // sets up its bank controller and RAM. The cartridge must outlive the
+        // mapping (GameBoy keeps it alive).
+        void insert_cartridge(const Cartridge& cartridge);
+
+        // ROM bank currently mapped at 0x4000-0x7FFF
+        uint16_t rom_bank() const { return state_.rom_bank; }
+
+        std::size_t cartridge_ram_size() const { return cartridge_ram_size_; }
+
+        const BankSwitchStats& bank_stats() const { return bank_stats_; }
+
+        // M-cycle counter the MBC3 clock runs on
+        void set_clock(const uint64_t* cycles) { clock_ = cycles; }
+
+        /* I/O registers
+         * Components claim registers in 0xFF00-0xFF7F and 0xFFFF with a
+         * read and/or write handler. Unclaimed registers behave as plain
+         * memory.
+         *
+         * A register whose value is worked out from the cycle counter can
+         * also say until when it stays the same (IoStable, the first cycle
+         * a read may differ); idle loop skipping needs it. Claimed reads
+         * without one count as changing every cycle.
+         */
+        using IoRead = uint8_t (*)(void* context, uint16_t address);
+        using IoWrite = void (*)(void* context, uint16_t address, uint8_t value);
+        using IoStable = uint64_t (*)(void* context, uint16_t address, uint64_t now);
+
+        void map_io(uint16_t address, IoRead read, IoWrite write, void* context, IoStable stable = nullptr);
+
+        // First cycle from now at which reading address could return
+        // something else without a write or a scheduler event in between
+        uint64_t stable_until(uint16_t address, uint64_t now) const;
+
+        /* Write tracking
+         * Caches of data decoded from memory (the CPU block cache, the PPU
+         * tile cache) watch the 256-byte pages they decoded from. Watched
+         * pages lose their direct write pointer, and the first write to one
+         * bumps the page's generation, which tells each cache its entries
+         * from that page are stale. The page then goes back to the fast path
+         * until something watches it again.
+         */
+        void watch_page(uint16_t address);
+        uint32_t page_generation(uint16_t address) const { return generation_[address >> 8]; }
+
+        // Stable addresses generated code compares against, see cpu/jit.h
+        const uint32_t* page_generation_ptr(uint16_t address) const { return &generation_[address >> 8]; }
+        const uint16_t* rom_bank_ptr() const { return &state_.rom_bank; }
+
+        // Memory and cartridge RAM ("MEM " section) and bank controller
+        // ("MBC " section). Loading re-derives the page tables and marks all
+        // decoded data stale.
+        void save_memory(StateWriter& out) const;
+        void load_memory(StateReader& in);
+        void save_banking(StateWriter& out) const { state_.mbc.save_state(out); }
+        void load_banking(StateReader& in);
+
+        // Re-derives the page tables from the arena after it was overwritten
+        // wholesale and marks all decoded data stale
+        void remap();
+
     private:
-        std::vector<uint8_t> ram_;
+        // Points count pages from first_page at host memory; null read or
+        // write sends that access to the slow path
+        void map_pages(uint8_t first_page, int count, const uint8_t* read, uint8_t* write);
+
+        // Re-points ROM and cartridge RAM pages at the banks the bank
+        // controller selects, or everything at plain memory
+        void map_cartridge();
+        void map_plain_memory();
+        uint8_t read_cartridge_ram(uint16_t address);
+        void write_cartridge_ram(uint16_t address, uint8_t value);
+        uint64_t now() const { return clock_ ? *clock_ : 0; }
+
+        uint8_t read_slow(uint16_t address);
+        void write_slow(uint16_t address, uint8_t value);
+        void invalidate_page(uint8_t page);
+        void invalidate_all_pages();
+
+        // Page of the same memory seen through echo RAM, or page itself
+        static uint8_t echo_page(uint8_t page);
+
+        MachineState& state_;
+
+        /* Cartridge */
+        const Cartridge* cartridge_ = nullptr;
+        std::size_t cartridge_ram_size_ = 0;
+        BankSwitchStats bank_stats_;
+        const uint64_t* clock_ = nullptr;
+
+        const uint8_t* read_pages_[256] = {};
+        uint8_t* write_pages_[256] = {};  // null for slow-path and watched pages
+        uint8_t* mapped_write_pages_[256] = {};  // write_pages_ before write tracking
+
+        struct IoHandler {
+            IoRead read = nullptr;
+            IoWrite write = nullptr;
+            void* context = nullptr;
+            IoStable stable = nullptr;
+        };
+        IoHandler io_[0x100];
+
+        bool watched_pages_[256] = {};
+        uint32_t generation_[256] = {};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,510 @@
+#include "ppu.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t stat_hblank = 0x08;
+constexpr uint8_t stat_vblank = 0x10;
+constexpr uint8_t stat_oam = 0x20;
+constexpr uint8_t stat_coincidence = 0x40;
+
+constexpr uint8_t lcdc_bg = 0x01;
+constexpr uint8_t lcdc_sprites = 0x02;
+constexpr uint8_t lcdc_tall_sprites = 0x04;
+constexpr uint8_t lcdc_bg_map = 0x08;
+constexpr uint8_t lcdc_unsigned_tiles = 0x10;
+constexpr uint8_t lcdc_window = 0x20;
+constexpr uint8_t lcdc_window_map = 0x40;
+
+constexpr uint8_t sprite_behind_bg = 0x80;
+constexpr uint8_t sprite_flip_y = 0x40;
+constexpr uint8_t sprite_flip_x = 0x20;
+constexpr uint8_t sprite_palette = 0x10;
+
+constexpr int sprites_per_line = 10;
+
+// One drawn line in this many is timed for RenderStats
+constexpr uint64_t line_sample_interval = 16;
+
+}
+
+PPU::PPU(MachineState& state, MMU& mmu, Scheduler& scheduler):
+    state_(state),
+    mmu_(mmu),
+    scheduler_(scheduler),
+    tile_cache_(state, mmu)
+{
+    select_renderer();
+}
+
+void PPU::connect() {
+    for (uint8_t reg : {io::LCDC, io::STAT, io::LY, io::LYC, io::DMA}) {
+        bool claimed = reg == io::STAT || reg == io::LY;
+        mmu_.map_io(0xFF00 | reg, claimed ? read_register : nullptr, write_register, this,
+                    claimed ? stable_until : nullptr);
+    }
+    scheduler_.set_handler(EventType::PPU, on_event, this);
+}
+
+void PPU::skip_boot_rom() {
+    state_.high[io::LCDC] = 0x91;
+    state_.high[io::STAT] = 0x00;
+    state_.high[io::BGP] = 0xFC;
+    state_.high[io::OBP0] = 0xFF;
+    state_.high[io::OBP1] = 0xFF;
+    turn_on(state_.cycles);
+}
+
+void PPU::copy_output(const PPU& other) {
+    std::memcpy(framebuffer_, other.framebuffer_, sizeof(framebuffer_));
+    decoder_ = other.decoder_;
+    tile_cache_enabled_ = other.tile_cache_enabled_;
+    render_interval_ = other.render_interval_;
+    // entries could match this machine's page generations by accident
+    tile_cache_.clear();
+    select_renderer();
+}
+
+void PPU::set_tile_decoder(TileDecoder decoder) {
+    if (!tile_decoder_available(decoder)) {
+        decoder = TileDecoder::Scalar;
+    }
+    decoder_ = decoder;
+    // cached rows were decoded the same way by every decoder, so they stay
+    select_renderer();
+}
+
+void PPU::set_tile_cache_enabled(bool enabled) {
+    if (enabled && !tile_cache_enabled_) {
+        // nothing kept it up to date while it was off
+        tile_cache_.clear();
+    }
+    tile_cache_enabled_ = enabled;
+    select_renderer();
+}
+
+void PPU::select_renderer() {
+    switch (decoder_) {
+        case TileDecoder::Scalar:
+            render_ = tile_cache_enabled_ ? &PPU::render<TileDecoder::Scalar, true> : &PPU::render<TileDecoder::Scalar, false>;
+            break;
+        case TileDecoder::SSE2:
+            render_ = tile_cache_enabled_ ? &PPU::render<TileDecoder::SSE2, true> : &PPU::render<TileDecoder::SSE2, false>;
+            break;
+        case TileDecoder::BMI2:
+            render_ = tile_cache_enabled_ ? &PPU::render<TileDecoder::BMI2, true> : &PPU::render<TileDecoder::BMI2, false>;
+            break;
+    }
+}
+
+/* Registers */
+uint8_t PPU::read_register(void* context, uint16_t address) {
+    PPU& ppu = *static_cast<PPU*>(context);
+    const PpuState& line = ppu.state_.ppu;
+    if ((address & 0xFF) == io::LY) {
+        return line.ly;
+    }
+    const uint8_t* high = ppu.state_.high;
+    uint8_t coincidence = line.ly == high[io::LYC] ? 0x04 : 0x00;
+    return 0x80 | (high[io::STAT] & 0x78) | coincidence | ppu.mode(ppu.state_.cycles);
+}
+
+// LY and the start of each line happen in events; the STAT mode changes
+// into drawing and HBlank are worked out from the clock
+uint64_t PPU::stable_until(void* context, uint16_t address, uint64_t now) {
+    const PPU& ppu = *static_cast<const PPU*>(context);
+    const PpuState& line = ppu.state_.ppu;
+    if ((address & 0xFF) != io::STAT || !ppu.lcd_on() || line.ly >= height) {
+        return UINT64_MAX;
+    }
+    uint64_t drawing = line.line_start + oam_scan_cycles;
+    uint64_t hblank = drawing + draw_cycles;
+    return now < drawing ? drawing : now < hblank ? hblank : UINT64_MAX;
+}
+
+void PPU::write_register(void* context, uint16_t address, uint8_t value) {
+    PPU& ppu = *static_cast<PPU*>(context);
+    uint8_t* high = ppu.state_.high;
+    uint64_t now = ppu.state_.cycles;
+    switch (address & 0xFF) {
+        case io::LCDC: {
+            bool was_on = ppu.lcd_on();
+            high[io::LCDC] = value;
+            if (ppu.lcd_on() != was_on) {
+                if (was_on) {
+                    ppu.turn_off();
+                } else {
+                    ppu.turn_on(now);
+                }
+            }
+            break;
+        }
+        case io::STAT: {
+            high[io::STAT] = value & 0x78; // mode and coincidence bits are read-only
+            if (!ppu.lcd_on()) {
+                break;
+            }
+            uint8_t mode = ppu.mode(now);
+            PpuState& line = ppu.state_.ppu;
+            if ((value & stat_hblank) && mode == 3 && line.next == PpuState::Step::LineStart) {
+                // HBlank source enabled while drawing: this line's mode 0 needs its event
+                line.next = PpuState::Step::HBlank;
+                ppu.scheduler_.schedule(EventType::PPU, line.line_start + oam_scan_cycles + draw_cycles);
+            }
+            ppu.update_stat(mode);
+            break;
+        }
+        case io::LY:
+            break; // read-only
+        case io::LYC:
+            high[io::LYC] = value;
+            if (ppu.lcd_on()) {
+                ppu.update_stat(ppu.mode(now));
+            }
+            break;
+        case io::DMA:
+            high[io::DMA] = value;
+            ppu.oam_dma(value);
+            break;
+    }
+}
+
+void PPU::oam_dma(uint8_t source) {
+    for (uint16_t i = 0; i < 0xA0; i++) {
+        state_.memory[0xFE00 + i] = mmu_.read(Address(static_cast<uint16_t>(source << 8 | i)));
+    }
+}
+
+/* Timing */
+void PPU::on_event(void* context, uint64_t deadline) {
+    PPU& ppu = *static_cast<PPU*>(context);
+    switch (ppu.state_.ppu.next) {
+        case PpuState::Step::LineStart: ppu.start_line(deadline); break;
+        case PpuState::Step::Draw: ppu.draw(); break;
+        case PpuState::Step::HBlank: ppu.hblank(); break;
+    }
+}
+
+void PPU::start_line(uint64_t deadline) {
+    PpuState& line = state_.ppu;
+    line.line_start = deadline;
+    if (++line.ly == lines) {
+        line.ly = 0;
+        line.window_line = 0;
+    }
+    if (line.ly < height) {
+        line.next = PpuState::Step::Draw;
+        scheduler_.schedule(EventType::PPU, deadline + oam_scan_cycles);
+        update_stat(2);
+        return;
+    }
+    if (line.ly == height) {
+        state_.high[io::IF] |= interrupt::vblank;
+        if (draws_frame(line.frames)) {
+            render_stats_.frames_drawn++;
+        } else {
+            render_stats_.frames_skipped++;
+        }
+        line.frames++;
+    }
+    line.next = PpuState::Step::LineStart;
+    scheduler_.schedule(EventType::PPU, deadline + cycles_per_line);
+    update_stat(1);
+}
+
+void PPU::draw() {
+    PpuState& line = state_.ppu;
+    if (!draws_frame(line.frames)) {
+        // the window line counter is state, it moves whether or not pixels are drawn
+        if (window_on_line(line.ly)) {
+            line.window_line++;
+        }
+        render_stats_.lines_skipped++;
+    } else if (render_stats_.lines_drawn++ % line_sample_interval == 0) {
+        auto start = std::chrono::steady_clock::now();
+        render_line(line.ly);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        render_stats_.timed_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        render_stats_.timed_lines++;
+    } else {
+        render_line(line.ly);
+    }
+    if (state_.high[io::STAT] & stat_hblank) {
+        line.next = PpuState::Step::HBlank;
+        scheduler_.schedule(EventType::PPU, line.line_start + oam_scan_cycles + draw_cycles);
+    } else {
+        line.next = PpuState::Step::LineStart;
+        scheduler_.schedule(EventType::PPU, line.line_start + cycles_per_line);
+    }
+    update_stat(3);
+}
+
+void PPU::hblank() {
+    PpuState& line = state_.ppu;
+    line.next = PpuState::Step::LineStart;
+    scheduler_.schedule(EventType::PPU, line.line_start + cycles_per_line);
+    update_stat(0);
+}
+
+void PPU::turn_on(uint64_t now) {
+    PpuState& line = state_.ppu;
+    line.ly = 0;
+    line.window_line = 0;
+    line.line_start = now;
+    line.stat_line = false;
+    line.next = PpuState::Step::Draw;
+    scheduler_.schedule(EventType::PPU, now + oam_scan_cycles);
+    update_stat(2);
+}
+
+// The screen goes blank and LY stays at 0 until the LCD is turned back on
+void PPU::turn_off() {
+    PpuState& line = state_.ppu;
+    scheduler_.cancel(EventType::PPU);
+    line.ly = 0;
+    line.stat_line = false;
+    line.next = PpuState::Step::LineStart;
+    std::memset(framebuffer_, 0, sizeof(framebuffer_));
+}
+
+uint8_t PPU::mode(uint64_t now) const {
+    const PpuState& line = state_.ppu;
+    if (!lcd_on()) {
+        return 0;
+    }
+    if (line.ly >= height) {
+        return 1;
+    }
+    uint64_t into_line = now - line.line_start;
+    return into_line < oam_scan_cycles ? 2 : into_line < oam_scan_cycles + draw_cycles ? 3 : 0;
+}
+
+void PPU::update_stat(uint8_t mode) {
+    PpuState& line = state_.ppu;
+    uint8_t stat = state_.high[io::STAT];
+    bool raised = ((stat & stat_hblank) && mode == 0) ||
+                  ((stat & stat_vblank) && mode == 1) ||
+                  ((stat & stat_oam) && mode == 2) ||
+                  ((stat & stat_coincidence) && line.ly == state_.high[io::LYC]);
+    if (raised && !line.stat_line) {
+        state_.high[io::IF] |= interrupt::stat;
+    }
+    line.stat_line = raised;
+}
+
+bool PPU::window_on_line(uint8_t ly) const {
+    const uint8_t* high = state_.high;
+    uint8_t lcdc = high[io::LCDC];
+    return (lcdc & lcdc_bg) && (lcdc & lcdc_window) && high[io::WY] <= ly && high[io::WX] - 7 < width;
+}
+
+/* Rendering
+ * Lines are built in padded buffers: colour indices with a tile's margin
+ * either side and shades with 8 pixels either side, so sprites hanging off
+ * the screen edge and the fine scroll need no clipping. With a SIMD tile
+ * decoder the palette lookup and sprite merge run 16 and 8 pixels at a
+ * time as well; the scalar path does them per pixel.
+ */
+namespace {
+
+constexpr int margin = 8;
+
+#ifdef __SSE2__
+// Shade of each of 16 colour indices
+inline __m128i apply_palette(__m128i index, uint8_t palette) {
+    __m128i shades = _mm_setzero_si128();
+    for (int i = 0; i < 4; i++) {
+        __m128i match = _mm_cmpeq_epi8(index, _mm_set1_epi8(static_cast<char>(i)));
+        shades = _mm_or_si128(shades, _mm_and_si128(match, _mm_set1_epi8(static_cast<char>((palette >> (i * 2)) & 3))));
+    }
+    return shades;
+}
+#endif
+
+template <TileDecoder D>
+void map_palette(const uint8_t* indices, uint8_t palette, uint8_t* out, int count) {
+    int x = 0;
+#ifdef __SSE2__
+    if constexpr (D != TileDecoder::Scalar) {
+        for (; x + 16 <= count; x += 16) {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), apply_palette(index, palette));
+        }
+    }
+#endif
+    for (; x < count; x++) {
+        out[x] = (palette >> (indices[x] * 2)) & 3;
+    }
+}
+
+// Merges one sprite's 8 decoded pixels into line at the same x as
+// background and covered (0xFF where a higher priority sprite already drew)
+template <TileDecoder D>
+void blend_sprite(uint64_t pixels, uint8_t palette, bool behind_bg,
+                  const uint8_t* background, uint8_t* covered, uint8_t* line) {
+#ifdef __SSE2__
+    if constexpr (D != TileDecoder::Scalar) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i index = _mm_cvtsi64_si128(static_cast<int64_t>(pixels));
+        __m128i opaque = _mm_andnot_si128(_mm_cmpeq_epi8(index, zero), _mm_set1_epi8(-1));
+        __m128i taken = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(covered));
+        __m128i draw = _mm_andnot_si128(taken, opaque);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(covered), _mm_or_si128(taken, opaque));
+        if (behind_bg) {
+            __m128i bg = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(background));
+            draw = _mm_and_si128(draw, _mm_cmpeq_epi8(bg, zero));
+        }
+        __m128i shade = apply_palette(index, palette);
+        __m128i old = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(line));
+        __m128i merged = _mm_or_si128(_mm_andnot_si128(draw, old), _mm_and_si128(draw, shade));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(line), merged);
+        return;
+    }
+#endif
+    uint8_t index[8];
+    std::memcpy(index, &pixels, 8);
+    for (int j = 0; j < 8; j++) {
+        if (!index[j] || covered[j]) {
+            continue;
+        }
+        covered[j] = 0xFF;
+        if (!(behind_bg && background[j])) {
+            line[j] = (palette >> (index[j] * 2)) & 3;
+        }
+    }
+}
+
+}
+
+template <TileDecoder D, bool Cached>
+uint64_t PPU::tile_row(unsigned tile, unsigned row) {
+    if (Cached) {
+        return tile_cache_.row<D>(tile, row);
+    }
+    const uint8_t* data = state_.memory + 0x8000 + tile * 16 + row * 2;
+    return decode_tile_row<D>(data[0], data[1]);
+}
+
+template <TileDecoder D, bool Cached>
+void PPU::fetch_tiles(uint16_t map, uint8_t y, uint8_t column, int count, uint8_t* out) {
+    const uint8_t* map_row = state_.memory + 0x8000 + map + (y >> 3) * 32;
+    bool unsigned_tiles = state_.high[io::LCDC] & lcdc_unsigned_tiles;
+    // gathered locally and copied once: a store through out may alias
+    // anything, which would make every tile reload the cache's state
+    uint64_t rows[width / 8 + 1];
+    for (int i = 0; i < count; i++) {
+        uint8_t tile = map_row[(column + i) & 31];
+        // tiles 0-127 come from 0x9000 in signed mode, 128-255 are shared
+        unsigned index = unsigned_tiles || tile >= 0x80 ? tile : 0x100u + tile;
+        rows[i] = tile_row<D, Cached>(index, y & 7);
+    }
+    std::memcpy(out, rows, count * 8);
+}
+
+template <TileDecoder D, bool Cached>
+void PPU::render(uint8_t ly) {
+    const uint8_t* high = state_.high;
+    uint8_t lcdc = high[io::LCDC];
+    if (Cached) {
+        tile_cache_.sync();
+    }
+
+    // colour indices from the tile boundary left of SCX, for sprite priority
+    alignas(16) uint8_t tiles[margin + width + 8 + margin] = {};
+    uint8_t* background = tiles + margin;
+    if (lcdc & lcdc_bg) {
+        uint8_t scx = high[io::SCX];
+        uint8_t y = static_cast<uint8_t>(ly + high[io::SCY]);
+        fetch_tiles<D, Cached>(lcdc & lcdc_bg_map ? 0x1C00 : 0x1800, y, scx >> 3, width / 8 + 1, tiles + margin);
+        background += scx & 7;
+
+        if (window_on_line(ly)) {
+            int window_x = high[io::WX] - 7;
+            uint8_t window[width + 8];
+            int skip = std::max(-window_x, 0);  // WX below 7 starts off screen
+            int start = std::max(window_x, 0);
+            int count = (width - start + skip + 7) / 8;
+            fetch_tiles<D, Cached>(lcdc & lcdc_window_map ? 0x1C00 : 0x1800, state_.ppu.window_line, 0, count, window);
+            std::memcpy(background + start, window + skip, width - start);
+            state_.ppu.window_line++;
+        }
+    }
+
+    alignas(16) uint8_t shades[margin + width + margin];
+    if (lcdc & lcdc_bg) {
+        map_palette<D>(background, high[io::BGP], shades + margin, width);
+    } else {
+        // blank white whatever BGP says; sprites still see colour 0 behind them
+        std::memset(shades + margin, 0, width);
+    }
+    if (lcdc & lcdc_sprites) {
+        draw_sprites<D, Cached>(ly, background, shades + margin);
+    }
+    std::memcpy(framebuffer_ + ly * width, shades + margin, width);
+}
+
+// The ten sprites OAM scan finds first are drawn; where they overlap the
+// one with the smaller X wins, then the one earlier in OAM. A winning
+// pixel behind a non-zero background pixel hides the sprites below it too.
+// background and line may be read and written 8 pixels either side.
+template <TileDecoder D, bool Cached>
+void PPU::draw_sprites(uint8_t ly, const uint8_t* background, uint8_t* line) {
+    const uint8_t* oam = state_.memory + 0xFE00;
+    int sprite_height = state_.high[io::LCDC] & lcdc_tall_sprites ? 16 : 8;
+
+    const uint8_t* found[sprites_per_line];
+    int count = 0;
+    for (int i = 0; i < 40 && count < sprites_per_line; i++) {
+        const uint8_t* sprite = oam + i * 4;
+        if (static_cast<unsigned>(ly - (sprite[0] - 16)) < static_cast<unsigned>(sprite_height)) {
+            found[count++] = sprite;
+        }
+    }
+    std::stable_sort(found, found + count, [](const uint8_t* a, const uint8_t* b) { return a[1] < b[1]; });
+
+    uint8_t covered[margin + width + margin] = {};
+    for (int i = 0; i < count; i++) {
+        const uint8_t* sprite = found[i];
+        int x = sprite[1] - 8;
+        if (x >= width) {
+            continue;
+        }
+        uint8_t attributes = sprite[3];
+        int row = ly - (sprite[0] - 16);
+        if (attributes & sprite_flip_y) {
+            row = sprite_height - 1 - row;
+        }
+        // 8x16 sprites are an even tile and the one after it
+        unsigned tile = (sprite_height == 16 ? sprite[2] & 0xFE : sprite[2]) + (row >> 3);
+        uint64_t pixels = tile_row<D, Cached>(tile, row & 7);
+        if (attributes & sprite_flip_x) {
+            pixels = __builtin_bswap64(pixels); // one pixel per byte, so mirroring reverses the bytes
+        }
+        uint8_t palette = state_.high[attributes & sprite_palette ? io::OBP1 : io::OBP0];
+        blend_sprite<D>(pixels, palette, attributes & sprite_behind_bg,
+                        background + x, covered + margin + x, line + x);
+    }
+}
+
+/* Save states */
+void PPU::save_state(StateWriter& out) const {
+    const PpuState& line = state_.ppu;
+    out.u64(line.line_start);
+    out.u8(line.ly);
+    out.u8(line.window_line);
+    out.boolean(line.stat_line);
+    out.u8(static_cast<uint8_t>(line.next));
+    out.u64(line.frames);
+}
+
+void PPU::load_state(StateReader& in) {
+    PpuState& line = state_.ppu;
+    line.line_start = in.u64();
+    line.ly = in.u8();
+    line.window_line = in.u8();
+    line.stat_line = in.boolean();
+    line.next = static_cast<PpuState::Step>(std::min<uint8_t>(in.u8(), static_cast<uint8_t>(PpuState::Step::HBlank)));
+    line.frames = in.u64();
+}
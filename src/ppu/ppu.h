@@ -0,0 +1,167 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <cstdint>
+#include "io_registers.h"
+#include "machine_state.h"
+#include "mmu.h"
+#include "scheduler.h"
+#include "state.h"
+#include "tile_cache.h"
+#include "tile_decode.h"
+
+// Host-side rendering counters
+struct RenderStats {
+    uint64_t frames_drawn = 0;
+    uint64_t frames_skipped = 0;  // frames left out by the render interval
+    uint64_t lines_drawn = 0;
+    uint64_t lines_skipped = 0;
+    uint64_t timed_lines = 0;     // drawn lines sampled for host time
+    uint64_t timed_ns = 0;
+
+    double ns_per_line() const { return timed_lines ? static_cast<double>(timed_ns) / timed_lines : 0.0; }
+    double ns_per_frame() const { return ns_per_line() * 144; }
+
+    // Host time the skipped lines would have taken at the sampled cost of
+    // drawn ones; 0 until some line has been drawn
+    double saved_ns() const { return ns_per_line() * lines_skipped; }
+};
+
+/* Picture processing unit
+ * Renders a whole scanline at once, at the start of the line's drawing
+ * mode, from the LCD registers, VRAM and OAM as they are at that moment.
+ * Register writes made during HBlank or mode 2 therefore show up on the
+ * next line drawn, which covers the usual raster effects; changes in the
+ * middle of mode 3 land on a line boundary instead of a pixel.
+ *
+ * Each line is 114 M-cycles: mode 2 (OAM scan) for 20, mode 3 (drawing)
+ * for 43, mode 0 (HBlank) for the rest. Lines 144-153 are VBlank (mode 1).
+ * The PPU schedules one event at the start of each line and one at mode 3
+ * of visible lines; the mode 0 event is only scheduled while STAT has its
+ * HBlank interrupt enabled. LY and STAT reads work out the mode from the
+ * cycle counter, so nothing runs per cycle.
+ *
+ * Line position and STAT state live in the arena (PpuState), the
+ * registers in MachineState::high. The framebuffer is output, not state:
+ * it is left out of save states and refilled as the next frame is drawn.
+ *
+ * Frames can be left undrawn (set_render_interval) when only memory
+ * matters. Skipping only leaves out pixel composition: events, LY, STAT,
+ * interrupts and the window line counter run exactly as when drawing, so
+ * machines with different intervals stay in identical states.
+ */
+class PPU {
+    public:
+        static constexpr int width = 160;
+        static constexpr int height = 144;
+        static constexpr int lines = 154;
+        static constexpr uint64_t cycles_per_line = 114;
+        static constexpr uint64_t oam_scan_cycles = 20;
+        static constexpr uint64_t draw_cycles = 43;
+
+        PPU(MachineState& state, MMU& mmu, Scheduler& scheduler);
+        PPU(const PPU&) = delete;
+        PPU& operator=(const PPU&) = delete;
+
+        // Claims the LCD registers and the PPU event
+        void connect();
+
+        // LCD on with the registers the boot ROM leaves behind
+        void skip_boot_rom();
+
+        // Takes over other's framebuffer and rendering options (its arena
+        // state comes with the arena copy); the tile cache starts empty
+        void copy_output(const PPU& other);
+
+        // 160x144 shades, row-major, 0 (lightest) to 3 (darkest)
+        const uint8_t* framebuffer() const { return framebuffer_; }
+
+        // VBlanks entered since power on
+        uint64_t frames() const { return state_.ppu.frames; }
+
+        // Draws line ly into the framebuffer from the current registers,
+        // VRAM and OAM. Called by the line events; public for benchmarks.
+        void render_line(uint8_t ly) { (this->*render_)(ly); }
+
+        void set_tile_decoder(TileDecoder decoder);
+        TileDecoder tile_decoder() const { return decoder_; }
+
+        // Draws from pre-decoded tiles (tile_cache.h) rather than decoding
+        // every tile row as it is drawn. Off by default: the per-line sync
+        // and the watched VRAM writes cost as much as the decoders save,
+        // even when VRAM never changes (see --bench-ppu).
+        void set_tile_cache_enabled(bool enabled);
+        bool tile_cache_enabled() const { return tile_cache_enabled_; }
+        const TileCache& tile_cache() const { return tile_cache_; }
+
+        // Draws one frame in every interval: 1 (the default) draws all of
+        // them, 0 none. The framebuffer keeps the last frame drawn.
+        void set_render_interval(unsigned interval) { render_interval_ = interval; }
+        unsigned render_interval() const { return render_interval_; }
+        const RenderStats& render_stats() const { return render_stats_; }
+
+        // "PPU " section: line position and STAT state
+        void save_state(StateWriter& out) const;
+        void load_state(StateReader& in);
+
+    private:
+        static uint8_t read_register(void* context, uint16_t address);
+        static uint64_t stable_until(void* context, uint16_t address, uint64_t now);
+        static void write_register(void* context, uint16_t address, uint8_t value);
+        static void on_event(void* context, uint64_t deadline);
+
+        // Whether the frame that follows the given number of VBlanks is drawn
+        bool draws_frame(uint64_t frame) const { return render_interval_ && frame % render_interval_ == 0; }
+
+        // Whether the window covers part of line ly
+        bool window_on_line(uint8_t ly) const;
+
+        void start_line(uint64_t deadline);
+        void draw();
+        void hblank();
+
+        bool lcd_on() const { return state_.high[io::LCDC] & 0x80; }
+        void turn_on(uint64_t now);
+        void turn_off();
+
+        uint8_t mode(uint64_t now) const;
+
+        // Raises the STAT interrupt on a rising edge of its sources
+        void update_stat(uint8_t mode);
+
+        // Copies 160 bytes from value << 8 to OAM at once rather than over
+        // 160 cycles
+        void oam_dma(uint8_t source);
+
+        // Picks render_ for the decoder and tile cache setting
+        void select_renderer();
+
+        template <TileDecoder D, bool Cached>
+        void render(uint8_t ly);
+
+        // Row 0-7 of tile 0-383 as 8 colour indices
+        template <TileDecoder D, bool Cached>
+        uint64_t tile_row(unsigned tile, unsigned row);
+
+        // Decodes count tiles of one background map row into out
+        template <TileDecoder D, bool Cached>
+        void fetch_tiles(uint16_t map, uint8_t y, uint8_t column, int count, uint8_t* out);
+
+        template <TileDecoder D, bool Cached>
+        void draw_sprites(uint8_t ly, const uint8_t* background, uint8_t* line);
+
+        MachineState& state_;
+        MMU& mmu_;
+        Scheduler& scheduler_;
+
+        TileDecoder decoder_ = best_tile_decoder();
+        bool tile_cache_enabled_ = false;
+        unsigned render_interval_ = 1;
+        RenderStats render_stats_;
+        void (PPU::*render_)(uint8_t) = nullptr;
+        TileCache tile_cache_;
+
+        uint8_t framebuffer_[width * height] = {};
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PPU_STATE_H
+#define PPU_STATE_H
+
+#include <cstdint>
+
+// Scanline position and STAT bookkeeping, kept in the machine state arena.
+// The LCD registers themselves sit in MachineState::high like any other
+// I/O register.
+struct PpuState {
+    enum class Step : uint8_t {
+        LineStart,  // LY advances, mode 2 (or 1 from line 144)
+        Draw,       // mode 3, the line is rendered
+        HBlank      // mode 0, only scheduled while STAT asks for it
+    };
+
+    uint64_t line_start = 0;  // cycle the current line began
+    uint8_t ly = 0;
+    uint8_t window_line = 0;  // window rows drawn this frame
+    bool stat_line = false;   // STAT interrupt line, requests on rising edge
+    Step next = Step::LineStart;
+    uint64_t frames = 0;      // VBlanks entered since power on
+};
+
+#endif
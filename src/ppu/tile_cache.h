@@ -0,0 +1,90 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include "machine_state.h"
+#include "mmu.h"
+#include "tile_decode.h"
+
+/* Decoded tile cache
+ * The 384 tiles at 0x8000-0x97FF decoded to one colour index per byte, so
+ * drawing a tile row is an 8-byte load instead of a bit-plane shuffle.
+ *
+ * Decoding a tile watches its page (MMU::watch_page), so the first write
+ * to the page bumps its generation. sync(), called before each line,
+ * compares the 24 tile pages' generations with the ones it last saw and
+ * marks all 16 tiles of a changed page dirty; later writes to that page
+ * take the fast path again until one of its tiles is decoded. Dirty tiles
+ * are decoded when a line next uses them, so a frame costs as many
+ * decodes as the tiles it actually changed, and a lookup is one flag test.
+ *
+ * Derived entirely from VRAM, so it is not machine state: a copied or
+ * reloaded machine starts with an empty cache.
+ */
+class TileCache {
+    public:
+        static constexpr unsigned tiles = 384;
+
+        TileCache(const MachineState& state, MMU& mmu):
+            state_(state),
+            mmu_(mmu)
+        {
+            clear();
+        }
+
+        TileCache(const TileCache&) = delete;
+        TileCache& operator=(const TileCache&) = delete;
+
+        // Marks tiles on pages written since the last sync dirty
+        void sync() {
+            for (unsigned page = 0; page < pages; page++) {
+                uint32_t generation = mmu_.page_generation(address(page * tiles_per_page));
+                if (generation != generation_[page]) {
+                    generation_[page] = generation;
+                    std::fill(dirty_ + page * tiles_per_page, dirty_ + (page + 1) * tiles_per_page, true);
+                }
+            }
+        }
+
+        // Row 0-7 of tile 0-383 as 8 colour indices, leftmost first in
+        // memory. Only valid after sync() for VRAM written since.
+        template <TileDecoder D>
+        uint64_t row(unsigned tile, unsigned row) {
+            if (dirty_[tile]) {
+                decode<D>(tile);
+            }
+            return rows_[tile][row];
+        }
+
+        void clear() { std::fill(dirty_, dirty_ + tiles, true); }
+
+        uint64_t decodes() const { return decodes_; }
+
+    private:
+        static constexpr unsigned tiles_per_page = 16;
+        static constexpr unsigned pages = tiles / tiles_per_page;
+
+        static uint16_t address(unsigned tile) { return static_cast<uint16_t>(0x8000 + tile * 16); }
+
+        template <TileDecoder D>
+        void decode(unsigned tile) {
+            mmu_.watch_page(address(tile));
+            const uint8_t* data = state_.memory + address(tile);
+            for (unsigned r = 0; r < 8; r++) {
+                rows_[tile][r] = decode_tile_row<D>(data[r * 2], data[r * 2 + 1]);
+            }
+            dirty_[tile] = false;
+            decodes_++;
+        }
+
+        const MachineState& state_;
+        MMU& mmu_;
+
+        uint64_t rows_[tiles][8];
+        bool dirty_[tiles];
+        uint32_t generation_[pages] = {}; // page generations at the last sync
+        uint64_t decodes_ = 0;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TILE_DECODE_H
+#define TILE_DECODE_H
+
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+/* Tile row decoding
+ * A tile row is two bytes, one per bit plane: bit 7 of each is the leftmost
+ * pixel, the low plane holds bit 0 of the colour index and the high plane
+ * bit 1. The decoders turn a row into eight colour indices (0-3), returned
+ * as eight bytes in memory order, leftmost pixel first, ready to be copied
+ * into a line buffer.
+ *
+ * Scalar spreads each plane through a 256-entry table; SSE2 tests all
+ * sixteen plane bits in one compare; BMI2 deposits each plane's bits into
+ * the low bits of eight bytes with pdep. SSE2 is part of x86-64, BMI2 needs
+ * -mbmi2 (or a -march that has it). pdep is microcoded and slow on AMD
+ * before Zen 3, so benchmark before preferring it there (--bench-ppu).
+ */
+enum class TileDecoder : uint8_t {
+    Scalar,
+    SSE2,
+    BMI2
+};
+
+constexpr bool tile_decoder_available(TileDecoder decoder) {
+    switch (decoder) {
+        case TileDecoder::Scalar: return true;
+#ifdef __SSE2__
+        case TileDecoder::SSE2: return true;
+#endif
+#ifdef __BMI2__
+        case TileDecoder::BMI2: return true;
+#endif
+        default: return false;
+    }
+}
+
+constexpr TileDecoder best_tile_decoder() {
+    return tile_decoder_available(TileDecoder::BMI2) ? TileDecoder::BMI2 :
+           tile_decoder_available(TileDecoder::SSE2) ? TileDecoder::SSE2 : TileDecoder::Scalar;
+}
+
+inline const char* tile_decoder_name(TileDecoder decoder) {
+    switch (decoder) {
+        case TileDecoder::Scalar: return "scalar";
+        case TileDecoder::SSE2: return "sse2";
+        case TileDecoder::BMI2: return "bmi2";
+    }
+    return "?";
+}
+
+namespace tile_decode_detail {
+
+// Byte i of entry v is bit 7 - i of v, built through memory so the table
+// is right on any host byte order
+struct PlaneTable {
+    uint64_t entries[256];
+
+    PlaneTable() {
+        for (int v = 0; v < 256; v++) {
+            uint8_t bytes[8];
+            for (int i = 0; i < 8; i++) {
+                bytes[i] = (v >> (7 - i)) & 1;
+            }
+            std::memcpy(&entries[v], bytes, 8);
+        }
+    }
+};
+
+inline const PlaneTable& plane_table() {
+    static const PlaneTable table;
+    return table;
+}
+
+}
+
+// Unavailable decoders fall back to the scalar one
+template <TileDecoder D>
+inline uint64_t decode_tile_row(uint8_t low, uint8_t high) {
+    const uint64_t* table = tile_decode_detail::plane_table().entries;
+    return table[low] | table[high] << 1;
+}
+
+#ifdef __SSE2__
+template <>
+inline uint64_t decode_tile_row<TileDecoder::SSE2>(uint8_t low, uint8_t high) {
+    // low plane broadcast to bytes 0-7, high plane to bytes 8-15
+    const __m128i bits = _mm_setr_epi8(char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                       char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i weights = _mm_set_epi64x(0x0202020202020202, 0x0101010101010101);
+    __m128i planes = _mm_set_epi64x(static_cast<int64_t>(high * 0x0101010101010101ull),
+                                    static_cast<int64_t>(low * 0x0101010101010101ull));
+    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(planes, bits), bits);
+    __m128i indices = _mm_and_si128(set, weights);
+    indices = _mm_or_si128(indices, _mm_srli_si128(indices, 8));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(indices));
+}
+#endif
+
+#ifdef __BMI2__
+template <>
+inline uint64_t decode_tile_row<TileDecoder::BMI2>(uint8_t low, uint8_t high) {
+    // pdep puts bit 0 (the rightmost pixel) in byte 0, so swap the bytes
+    uint64_t indices = _pdep_u64(low, 0x0101010101010101) | _pdep_u64(high, 0x0202020202020202);
+    return __builtin_bswap64(indices);
+}
+#endif
+
+#endif
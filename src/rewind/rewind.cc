@@ -0,0 +1,198 @@
+#include "rewind.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Zero runs shorter than this stay inside a literal, which bounds the
+// encoded size of any delta to the state size plus a few bytes
+constexpr std::size_t min_zero_run = 4;
+constexpr std::size_t delta_slack = 16;
+constexpr std::size_t entry_overhead = 8;
+
+uint8_t* put_varint(uint8_t* out, std::size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+const uint8_t* get_varint(const uint8_t* in, std::size_t& value) {
+    value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= std::size_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return in;
+        }
+    }
+}
+
+// First index at or after i where a and b differ, n if none
+std::size_t skip_equal(const uint8_t* a, const uint8_t* b, std::size_t i, std::size_t n) {
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        if (x != y) {
+            break;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+}
+
+RewindBuffer::RewindBuffer(const GameBoy& gameboy, std::size_t capacity_bytes, unsigned interval_frames):
+    interval_(std::max(interval_frames, 1u)),
+    ring_(capacity_bytes)
+{
+    reserve(gameboy.state_size());
+}
+
+void RewindBuffer::capture(const GameBoy& gameboy) {
+    if (++frames_ < interval_) {
+        return;
+    }
+    frames_ = 0;
+    // only allocates for a cartridge with more RAM than the buffer has seen
+    reserve(gameboy.state_size());
+    gameboy.save_state(capture_);
+
+    if (has_newest_ && capture_.size() == newest_.size()) {
+        std::size_t length = encode(newest_.data(), capture_.data());
+        push(delta_.data(), length);
+    } else {
+        // first capture, or a different cartridge: older deltas no longer apply
+        clear();
+    }
+    std::swap(newest_, capture_);
+    has_newest_ = true;
+}
+
+bool RewindBuffer::step_back(GameBoy& gameboy) {
+    if (!has_newest_) {
+        return false;
+    }
+    gameboy.load_state(newest_);
+    frames_ = 0;
+
+    if (entries_ == 0) {
+        has_newest_ = false;
+        return true;
+    }
+    // newest delta turns newest_ into the state captured before it
+    uint32_t length = read_length((head_ + ring_.size() - 4) % ring_.size());
+    std::size_t start = (head_ + ring_.size() - 4 - length) % ring_.size();
+    read_ring(start, delta_.data(), length);
+    decode(delta_.data(), length);
+
+    head_ = (head_ + ring_.size() - length - entry_overhead) % ring_.size();
+    used_ -= length + entry_overhead;
+    entries_--;
+    return true;
+}
+
+void RewindBuffer::clear() {
+    tail_ = head_ = used_ = entries_ = 0;
+    has_newest_ = false;
+    frames_ = 0;
+}
+
+void RewindBuffer::reserve(std::size_t state_size) {
+    newest_.reserve(state_size);
+    capture_.reserve(state_size);
+    if (delta_.size() < state_size + delta_slack) {
+        delta_.resize(state_size + delta_slack);
+    }
+}
+
+// delta_ was sized for the state by reserve()
+std::size_t RewindBuffer::encode(const uint8_t* older, const uint8_t* newer) {
+    std::size_t n = newest_.size();
+    uint8_t* out = delta_.data();
+    std::size_t pos = 0;
+    while (pos < n) {
+        std::size_t start = skip_equal(older, newer, pos, n);
+        std::size_t end = start;
+        while (end < n) {
+            std::size_t equal = skip_equal(older, newer, end, std::min(end + min_zero_run, n));
+            if (equal == end + min_zero_run || equal == n) {
+                break;
+            }
+            end = equal + 1;
+        }
+        out = put_varint(out, start - pos);
+        out = put_varint(out, end - start);
+        for (std::size_t i = start; i < end; i++) {
+            *out++ = older[i] ^ newer[i];
+        }
+        pos = end;
+    }
+    return static_cast<std::size_t>(out - delta_.data());
+}
+
+void RewindBuffer::decode(const uint8_t* delta, std::size_t length) {
+    const uint8_t* end = delta + length;
+    uint8_t* state = newest_.data();
+    while (delta < end) {
+        std::size_t zeros, literal;
+        delta = get_varint(delta, zeros);
+        delta = get_varint(delta, literal);
+        state += zeros;
+        for (std::size_t i = 0; i < literal; i++) {
+            *state++ ^= *delta++;
+        }
+    }
+}
+
+void RewindBuffer::push(const uint8_t* data, std::size_t length) {
+    std::size_t total = length + entry_overhead;
+    if (total > ring_.size()) {
+        dropped_ += entries_;
+        tail_ = head_ = used_ = entries_ = 0;
+        return;
+    }
+    while (ring_.size() - used_ < total) {
+        pop_oldest();
+    }
+    uint32_t length32 = static_cast<uint32_t>(length);
+    write_ring(head_, &length32, 4);
+    write_ring((head_ + 4) % ring_.size(), data, length);
+    write_ring((head_ + 4 + length) % ring_.size(), &length32, 4);
+    head_ = (head_ + total) % ring_.size();
+    used_ += total;
+    entries_++;
+}
+
+void RewindBuffer::pop_oldest() {
+    std::size_t total = read_length(tail_) + entry_overhead;
+    tail_ = (tail_ + total) % ring_.size();
+    used_ -= total;
+    entries_--;
+    dropped_++;
+}
+
+uint32_t RewindBuffer::read_length(std::size_t at) const {
+    uint32_t length;
+    read_ring(at, &length, 4);
+    return length;
+}
+
+void RewindBuffer::write_ring(std::size_t at, const void* data, std::size_t length) {
+    std::size_t first = std::min(length, ring_.size() - at);
+    std::memcpy(ring_.data() + at, data, first);
+    std::memcpy(ring_.data(), static_cast<const uint8_t*>(data) + first, length - first);
+}
+
+void RewindBuffer::read_ring(std::size_t at, void* out, std::size_t length) const {
+    std::size_t first = std::min(length, ring_.size() - at);
+    std::memcpy(out, ring_.data() + at, first);
+    std::memcpy(static_cast<uint8_t*>(out) + first, ring_.data(), length - first);
+}
@@ -0,0 +1,77 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "gameboy.h"
+
+/* Rewind history
+ * capture() is called once per frame and saves a state every interval
+ * frames. The newest state is kept whole; everything older is stored in a
+ * fixed-size byte ring as a chain of backward deltas, each the XOR of a
+ * state with the one after it, run-length encoded. Between two captures
+ * most of memory is unchanged, so a delta is mostly one long zero run and
+ * takes a few KiB instead of a whole state.
+ *
+ * step_back() loads the newest state and turns it into the one before by
+ * applying a single delta, so each step costs one decode and one
+ * load_state() no matter how deep the history is. When the ring is full
+ * the oldest deltas are dropped. All memory is allocated up front, or on
+ * the first capture from a cartridge with larger states than the buffer
+ * was built for; after that nothing allocates while capturing or
+ * rewinding.
+ *
+ * Layout of one ring entry: u32 length, length encoded bytes, u32 length
+ * again so the newest entry can be found from the ring's head. The encoded
+ * delta is a sequence of (varint zero run, varint literal count, literal
+ * bytes) covering the whole state.
+ */
+class RewindBuffer {
+    public:
+        RewindBuffer(const GameBoy& gameboy, std::size_t capacity_bytes, unsigned interval_frames = 10);
+
+        // Call after every frame
+        void capture(const GameBoy& gameboy);
+
+        // Restores the newest saved state and drops it from the history,
+        // false if there is nothing left to rewind to
+        bool step_back(GameBoy& gameboy);
+
+        void clear();
+
+        std::size_t states() const { return has_newest_ ? entries_ + 1 : 0; }
+        uint64_t history_frames() const { return states() * interval_; }
+        std::size_t bytes_used() const { return used_; }
+        std::size_t capacity() const { return ring_.size(); }
+        uint64_t dropped() const { return dropped_; } // deltas evicted from a full ring
+
+    private:
+        // Sizes the buffers for states of up to state_size bytes
+        void reserve(std::size_t state_size);
+        std::size_t encode(const uint8_t* older, const uint8_t* newer);
+        void decode(const uint8_t* delta, std::size_t length);
+
+        void push(const uint8_t* data, std::size_t length);
+        void pop_oldest();
+        uint32_t read_length(std::size_t at) const;
+        void write_ring(std::size_t at, const void* data, std::size_t length);
+        void read_ring(std::size_t at, void* out, std::size_t length) const;
+
+        unsigned interval_;
+        unsigned frames_ = 0;
+
+        std::vector<uint8_t> newest_;  // whole newest state
+        std::vector<uint8_t> capture_; // state being captured
+        std::vector<uint8_t> delta_;   // encoded delta, worst case sized
+        bool has_newest_ = false;
+
+        std::vector<uint8_t> ring_;
+        std::size_t tail_ = 0; // oldest entry
+        std::size_t head_ = 0; // end of the newest entry
+        std::size_t used_ = 0;
+        std::size_t entries_ = 0;
+        uint64_t dropped_ = 0;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "runner.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include "cpu.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void pin_to_core(unsigned id) {
+#ifdef __linux__
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(id % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}
+
+Runner::Runner(unsigned threads):
+    threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+    workers_(new Worker[threads_])
+{
+}
+
+Runner::~Runner() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : pool_) {
+        thread.join();
+    }
+}
+
+std::size_t Runner::add_instance(std::shared_ptr<const Cartridge> cartridge, Setup setup) {
+    auto instance = std::make_unique<Instance>();
+    instance->cartridge = std::move(cartridge);
+    instance->setup = std::move(setup);
+    instance->home = instances_.size() % threads_;
+    instances_.push_back(std::move(instance));
+    return instances_.size() - 1;
+}
+
+std::size_t Runner::add_clone(const GameBoy& source, Input input) {
+    auto instance = std::make_unique<Instance>();
+    instance->source = &source;
+    instance->input = std::move(input);
+    instance->home = instances_.size() % threads_;
+    if (!spare_.empty()) {
+        instance->gameboy = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    instances_.push_back(std::move(instance));
+    return instances_.size() - 1;
+}
+
+std::size_t Runner::fan_out(const GameBoy& source, std::size_t count, FanOutInput input) {
+    std::size_t first = instances_.size();
+    for (std::size_t clone = 0; clone < count; clone++) {
+        Input clone_input;
+        if (input) {
+            clone_input = [input, clone](GameBoy& gameboy, uint64_t frame) { input(gameboy, clone, frame); };
+        }
+        add_clone(source, std::move(clone_input));
+    }
+    return first;
+}
+
+void Runner::clear() {
+    for (auto& instance : instances_) {
+        if (instance->gameboy) {
+            spare_.push_back(std::move(instance->gameboy));
+        }
+    }
+    instances_.clear();
+}
+
+RunnerStats Runner::run_frames(uint64_t frames, uint64_t slice_frames) {
+    RunnerStats totals;
+    totals.threads = threads_;
+    if (instances_.empty() || frames == 0) {
+        return totals;
+    }
+    // an empty slice would never bring frames_left down
+    slice_frames = std::max<uint64_t>(slice_frames, 1);
+
+    std::vector<InstanceStats> before;
+    for (auto& instance : instances_) {
+        before.push_back(instance->stats);
+        instance->frames_left = frames;
+        workers_[instance->home].queue.push_back(instance.get());
+    }
+
+    uint64_t start = now_ns();
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        pending_ = instances_.size();
+        slice_frames_ = slice_frames;
+        active_ = threads_ - 1;
+        run_++;
+    }
+    if (pool_.empty()) {
+        for (unsigned id = 1; id < threads_; id++) {
+            pool_.emplace_back(&Runner::serve, this, id);
+        }
+    } else {
+        wake_.notify_all();
+    }
+    work(0); // the calling thread is worker 0
+    {
+        // the deques and instances are only ours again once every worker is out
+        std::unique_lock<std::mutex> guard(lock_);
+        done_.wait(guard, [this] { return active_ == 0; });
+    }
+    totals.wall_ns = now_ns() - start;
+
+    for (std::size_t i = 0; i < instances_.size(); i++) {
+        const InstanceStats& stats = instances_[i]->stats;
+        totals.frames += stats.frames - before[i].frames;
+        totals.instructions += stats.instructions - before[i].instructions;
+        totals.steals += stats.steals - before[i].steals;
+    }
+    return totals;
+}
+
+// Body of pool worker id: sleeps until run_frames() starts a run, takes
+// part in it and goes back to sleep
+void Runner::serve(unsigned id) {
+    // worker 0 is the caller's thread, whose affinity is left alone
+    if (pin_threads) {
+        pin_to_core(id);
+    }
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        wake_.wait(guard, [&] { return stop_ || run_ != seen; });
+        if (stop_) {
+            return;
+        }
+        seen = run_;
+        guard.unlock();
+        work(id);
+        guard.lock();
+        if (--active_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void Runner::work(unsigned id) {
+    std::unique_lock<std::mutex> guard(lock_);
+    uint64_t slice_frames = slice_frames_;
+    while (pending_ > 0) {
+        uint64_t requeues = requeues_;
+        guard.unlock();
+        Instance* instance = take(id);
+        if (!instance) {
+            // everything left is running on other workers, wait until one
+            // of them puts an instance back or the last one finishes
+            guard.lock();
+            idle_++;
+            wake_.wait(guard, [&] { return requeues_ != requeues || pending_ == 0; });
+            idle_--;
+            continue;
+        }
+        run_slice(id, *instance, slice_frames);
+
+        bool again = instance->frames_left > 0;
+        if (again) {
+            Worker& worker = workers_[id];
+            std::lock_guard<std::mutex> queue_guard(worker.lock);
+            worker.queue.push_back(instance);
+        }
+        guard.lock();
+        if (again) {
+            requeues_++;
+        } else {
+            pending_--;
+        }
+        if (idle_ > 0 && (again || pending_ == 0)) {
+            wake_.notify_all();
+        }
+    }
+}
+
+// Own deque from the back, otherwise steal from the front of the others
+Runner::Instance* Runner::take(unsigned id) {
+    {
+        Worker& worker = workers_[id];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (!worker.queue.empty()) {
+            Instance* instance = worker.queue.back();
+            worker.queue.pop_back();
+            return instance;
+        }
+    }
+    for (unsigned offset = 1; offset < threads_; offset++) {
+        Worker& victim = workers_[(id + offset) % threads_];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.queue.empty()) {
+            Instance* instance = victim.queue.front();
+            victim.queue.pop_front();
+            return instance;
+        }
+    }
+    return nullptr;
+}
+
+void Runner::run_slice(unsigned id, Instance& instance, uint64_t slice_frames) {
+    if (instance.source) {
+        // copied here so the clone's memory is first touched by the worker running it
+        if (instance.gameboy) {
+            *instance.gameboy = *instance.source;
+        } else {
+            instance.gameboy = std::make_unique<GameBoy>(*instance.source);
+        }
+        instance.source = nullptr;
+    } else if (!instance.gameboy) {
+        // created here so its memory is first touched by the worker running it
+        instance.gameboy = std::make_unique<GameBoy>();
+        instance.gameboy->load_cartridge(instance.cartridge);
+        if (instance.setup) {
+            instance.setup(*instance.gameboy);
+        }
+    }
+    GameBoy& gameboy = *instance.gameboy;
+    uint64_t frames = std::min(slice_frames, instance.frames_left);
+    uint64_t instructions = gameboy.cpu().instructions_retired();
+
+    uint64_t start = now_ns();
+    uint64_t ran = 0;
+    if (instance.input) {
+        for (uint64_t i = 0; i < frames; i++) {
+            instance.input(gameboy, instance.frame + i);
+            ran += gameboy.run_frames(1);
+        }
+    } else {
+        ran = gameboy.run_frames(frames);
+    }
+    instance.frame += frames;
+    instance.stats.busy_ns += now_ns() - start;
+
+    instance.frames_left -= frames;
+    instance.stats.frames += ran;
+    instance.stats.instructions += gameboy.cpu().instructions_retired() - instructions;
+    instance.stats.slices++;
+    if (id != instance.home) {
+        instance.stats.steals++;
+    }
+}
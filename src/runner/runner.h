@@ -0,0 +1,150 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cartridge.h"
+#include "gameboy.h"
+
+// Written only by the worker currently running the instance, padded so two
+// instances' counters never share a cache line
+struct alignas(64) InstanceStats {
+    uint64_t frames = 0;
+    uint64_t instructions = 0;
+    uint64_t busy_ns = 0; // host time spent running this instance
+    uint64_t slices = 0;
+    uint64_t steals = 0;  // slices run on a worker other than the instance's home worker
+};
+
+struct RunnerStats {
+    uint64_t frames = 0;
+    uint64_t instructions = 0;
+    uint64_t wall_ns = 0;
+    uint64_t steals = 0;
+    unsigned threads = 0;
+};
+
+/* Multi-instance runner
+ * Owns N independent machines and runs them headless across a pool of
+ * worker threads. Work is cut into slices of slice_frames frames for one
+ * instance. Every worker has its own deque of instances: it keeps running
+ * the instance at the back (whose state is hot in its cache) and idle
+ * workers steal from the front of someone else's deque, i.e. the instance
+ * that has waited longest.
+ *
+ * Instances are created by their home worker on its first slice. Machine
+ * arenas come from the StatePool chunks of that worker's NUMA node, so on
+ * a NUMA host each machine's memory sits on the node of the core that
+ * mostly runs it and never shares a huge page with machines of another
+ * node. Workers other than the calling thread are pinned to cores
+ * round-robin when the platform allows it; the calling thread is not, so
+ * the node of its instances is wherever it happens to run.
+ *
+ * The worker threads are started, and pinned, by the first run_frames()
+ * and kept until the runner is destroyed. Between runs they sleep on a
+ * condition variable, as does a worker that finds nothing to take or
+ * steal, until another worker puts an instance back or the run ends.
+ * Between runs the instances can be inspected or modified from the
+ * calling thread.
+ *
+ * Instances can also be clones of a running machine (add_clone(),
+ * fan_out()), e.g. to branch one game state into many rollouts. Clones are
+ * copied on the worker that first runs them, and clear() keeps the
+ * machines of removed instances so the next fan-out copies into them
+ * instead of allocating. A reused machine keeps the node it was created
+ * on.
+ */
+class Runner {
+    public:
+        using Setup = std::function<void(GameBoy&)>;
+        // Called before every frame with the number of frames the instance
+        // has run, to feed it its input sequence
+        using Input = std::function<void(GameBoy&, uint64_t frame)>;
+        using FanOutInput = std::function<void(GameBoy&, std::size_t clone, uint64_t frame)>;
+
+        // threads == 0 uses one worker per hardware thread
+        explicit Runner(unsigned threads = 0);
+        ~Runner();
+
+        // Adds a machine running cartridge; setup is called on the worker
+        // right after the machine is created, e.g. to enable the JIT
+        std::size_t add_instance(std::shared_ptr<const Cartridge> cartridge, Setup setup = {});
+
+        // Adds a copy of source made when the instance first runs; source
+        // must stay alive and unchanged until then
+        std::size_t add_clone(const GameBoy& source, Input input = {});
+
+        // Adds count clones of source, input receives the clone's number
+        // (0 to count - 1). Returns the index of the first clone.
+        std::size_t fan_out(const GameBoy& source, std::size_t count, FanOutInput input);
+
+        // Removes every instance, keeping their machines for reuse
+        void clear();
+
+        // Runs every instance for frames more frames, blocks until all are
+        // done. A slice_frames of 0 counts as 1.
+        RunnerStats run_frames(uint64_t frames, uint64_t slice_frames = 60);
+
+        std::size_t instances() const { return instances_.size(); }
+        unsigned threads() const { return threads_; }
+
+        // Null until the instance has run once
+        GameBoy* instance(std::size_t index) {
+            return instances_[index]->source ? nullptr : instances_[index]->gameboy.get();
+        }
+        const InstanceStats& stats(std::size_t index) const { return instances_[index]->stats; }
+
+        // Read when the workers start, i.e. on the first run_frames()
+        bool pin_threads = true;
+
+    private:
+        struct Instance {
+            InstanceStats stats;
+            std::unique_ptr<GameBoy> gameboy;
+            std::shared_ptr<const Cartridge> cartridge;
+            Setup setup;
+            const GameBoy* source = nullptr; // clone not made yet
+            Input input;
+            uint64_t frame = 0;
+            unsigned home = 0;
+            uint64_t frames_left = 0;
+        };
+
+        struct alignas(64) Worker {
+            std::mutex lock;
+            std::deque<Instance*> queue;
+        };
+
+        void serve(unsigned id);
+        void work(unsigned id);
+        Instance* take(unsigned id);
+        void run_slice(unsigned id, Instance& instance, uint64_t slice_frames);
+
+        unsigned threads_;
+        std::vector<std::unique_ptr<Instance>> instances_;
+        std::vector<std::unique_ptr<GameBoy>> spare_; // machines of cleared instances
+        std::unique_ptr<Worker[]> workers_;
+        std::vector<std::thread> pool_; // workers 1 to threads_ - 1
+
+        // Guards everything below; wake_ signals a new run, an instance put
+        // back into a deque or the end of the run, done_ a worker leaving it
+        std::mutex lock_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        uint64_t run_ = 0;           // number of run_frames() calls so far
+        uint64_t slice_frames_ = 0;
+        std::size_t pending_ = 0;    // instances with frames left
+        uint64_t requeues_ = 0;      // instances put back so far
+        unsigned idle_ = 0;          // workers waiting for something to steal
+        unsigned active_ = 0;        // pool workers still inside this run
+        bool stop_ = false;
+};
+
+#endif
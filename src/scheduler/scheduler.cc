@@ -0,0 +1,94 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <iterator>
+
+Scheduler::Scheduler(SchedulerState& state):
+    state_(state)
+{
+    std::fill(std::begin(state_.deadlines), std::end(state_.deadlines), never);
+    state_.heap_size = 0;
+}
+
+void Scheduler::set_handler(EventType type, Handler handler, void* context) {
+    handlers_[index(type)] = handler;
+    contexts_[index(type)] = context;
+}
+
+void Scheduler::schedule(EventType type, uint64_t deadline) {
+    state_.deadlines[index(type)] = deadline;
+
+    if (state_.heap_size >= SchedulerState::heap_capacity) {
+        // too many stale entries from rescheduling, rebuild from the deadlines
+        state_.heap_size = 0;
+        for (int i = 0; i < event_types; i++) {
+            if (state_.deadlines[i] != never) {
+                state_.heap[state_.heap_size++] = Entry{state_.deadlines[i], static_cast<EventType>(i)};
+            }
+        }
+        std::make_heap(state_.heap, state_.heap + state_.heap_size);
+    } else {
+        push(Entry{deadline, type});
+    }
+    drop_stale();
+}
+
+void Scheduler::cancel(EventType type) {
+    state_.deadlines[index(type)] = never;
+    drop_stale();
+}
+
+void Scheduler::run_due(uint64_t now) {
+    while (state_.heap_size && state_.heap[0].deadline <= now) {
+        Entry entry = state_.heap[0];
+        pop();
+        state_.deadlines[index(entry.type)] = never;
+        drop_stale();
+
+        Handler handler = handlers_[index(entry.type)];
+        if (handler) {
+            handler(contexts_[index(entry.type)], entry.deadline);
+        }
+    }
+}
+
+void Scheduler::push(Entry entry) {
+    state_.heap[state_.heap_size++] = entry;
+    std::push_heap(state_.heap, state_.heap + state_.heap_size);
+}
+
+void Scheduler::pop() {
+    std::pop_heap(state_.heap, state_.heap + state_.heap_size);
+    state_.heap_size--;
+}
+
+// Keeps the top of the heap a live entry so next_deadline() can just peek
+void Scheduler::drop_stale() {
+    while (state_.heap_size && stale(state_.heap[0])) {
+        pop();
+    }
+}
+
+void Scheduler::save_state(StateWriter& out) const {
+    out.u8(event_types);
+    for (uint64_t deadline : state_.deadlines) {
+        out.u64(deadline);
+    }
+}
+
+void Scheduler::load_state(StateReader& in) {
+    int count = in.u8();
+    state_.heap_size = 0;
+    for (int i = 0; i < event_types; i++) {
+        // event types added after the state was written stay idle
+        state_.deadlines[i] = i < count ? in.u64() : never;
+        if (state_.deadlines[i] != never) {
+            state_.heap[state_.heap_size++] = Entry{state_.deadlines[i], static_cast<EventType>(i)};
+        }
+    }
+    // states from builds that had more event types: none of those were
+    // ever scheduled, their deadlines are all idle
+    if (count > event_types) {
+        in.skip(8 * std::size_t(count - event_types));
+    }
+    std::make_heap(state_.heap, state_.heap + state_.heap_size);
+}
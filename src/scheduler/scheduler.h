@@ -0,0 +1,89 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+#include "state.h"
+
+// Hardware events that fire at a known future cycle. Each type has at most
+// one pending deadline; scheduling it again replaces the old one.
+enum class EventType : uint8_t {
+    PPU,        // next PPU mode change
+    Timer,      // TIMA overflow
+    Count
+};
+
+// Deadlines and heap, kept in the machine state arena
+struct SchedulerState {
+    static constexpr int event_types = static_cast<int>(EventType::Count);
+    // rescheduling leaves stale entries behind, the heap is rebuilt when full
+    static constexpr int heap_capacity = 4 * event_types;
+
+    struct Entry {
+        uint64_t deadline;
+        EventType type;
+
+        // std heap algorithms build a max-heap, so order by latest first
+        bool operator<(const Entry& other) const { return deadline > other.deadline; }
+    };
+
+    uint64_t deadlines[event_types];
+    uint8_t heap_size = 0;
+    Entry heap[heap_capacity];
+};
+
+/* Event scheduler
+ * Components register a handler per event type and schedule deadlines in
+ * M-cycles on GameBoy::cycles. The CPU runs uninterrupted up to
+ * next_deadline() and then calls run_due(), so no component polls per cycle.
+ *
+ * Pending events sit in a binary min-heap. Rescheduling or cancelling does
+ * not search the heap: the entry's deadline no longer matches its type's
+ * deadline and it is dropped when it reaches the top.
+ *
+ * Deadlines and heap live in the machine state arena; the scheduler itself
+ * only holds the handlers, which belong to the machine it is wired into.
+ */
+class Scheduler {
+    public:
+        static constexpr uint64_t never = UINT64_MAX;
+
+        // Called with the cycle the event was due at, which may be slightly
+        // before GameBoy::cycles. Handlers may schedule new events.
+        using Handler = void (*)(void* context, uint64_t deadline);
+
+        explicit Scheduler(SchedulerState& state);
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        void set_handler(EventType type, Handler handler, void* context);
+
+        void schedule(EventType type, uint64_t deadline);
+        void cancel(EventType type);
+        bool pending(EventType type) const { return state_.deadlines[index(type)] != never; }
+        uint64_t deadline(EventType type) const { return state_.deadlines[index(type)]; }
+
+        uint64_t next_deadline() const { return state_.heap_size ? state_.heap[0].deadline : never; }
+
+        // Fires, in deadline order, every event due at or before now
+        void run_due(uint64_t now);
+
+        // Deadlines only, handlers belong to the components
+        void save_state(StateWriter& out) const;
+        void load_state(StateReader& in);
+
+    private:
+        using Entry = SchedulerState::Entry;
+        static constexpr int event_types = SchedulerState::event_types;
+        static constexpr int index(EventType type) { return static_cast<int>(type); }
+
+        bool stale(const Entry& entry) const { return state_.deadlines[index(entry.type)] != entry.deadline; }
+        void push(Entry entry);
+        void pop();
+        void drop_stale();
+
+        SchedulerState& state_;
+        Handler handlers_[event_types] = {};
+        void* contexts_[event_types] = {};
+};
+
+#endif
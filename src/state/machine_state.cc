@@ -0,0 +1,109 @@
+#include "machine_state.h"
+#include <cstdlib>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::size_t huge_page_size = 2 << 20;
+
+// NUMA node of the core the calling thread is running on
+unsigned current_node() {
+#ifdef __linux__
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+        return node;
+    }
+#endif
+    return 0;
+}
+
+}
+
+StatePool::StatePool(std::size_t slot_size):
+    slot_size_((slot_size + alignof(MachineState) - 1) & ~(alignof(MachineState) - 1))
+{
+}
+
+StatePool::~StatePool() {
+    for (const Chunk& chunk : chunks_) {
+#ifdef __linux__
+        munmap(reinterpret_cast<void*>(chunk.start), chunk_size);
+#else
+        std::free(reinterpret_cast<void*>(chunk.start));
+#endif
+    }
+}
+
+void* StatePool::acquire() {
+    unsigned node = current_node();
+    std::lock_guard<std::mutex> guard(lock_);
+    if (free_.size() <= node) {
+        free_.resize(node + 1);
+    }
+    if (free_[node].empty()) {
+        grow(node);
+    }
+    void* slot = free_[node].back();
+    free_[node].pop_back();
+    return slot;
+}
+
+void StatePool::release(void* slot) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(slot);
+    std::lock_guard<std::mutex> guard(lock_);
+    for (const Chunk& chunk : chunks_) {
+        if (address - chunk.start < chunk_size) {
+            free_[chunk.node].push_back(slot);
+            return;
+        }
+    }
+}
+
+void StatePool::grow(unsigned node) {
+    void* chunk = nullptr;
+#ifdef __linux__
+    void* mem = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED) {
+        huge_page_chunks_++;
+    } else {
+        // over-allocate so the chunk can start on a huge page boundary
+        mem = mmap(nullptr, chunk_size + huge_page_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(mem);
+        uintptr_t aligned = (start + huge_page_size - 1) & ~(huge_page_size - 1);
+        if (aligned > start) {
+            munmap(mem, aligned - start);
+        }
+        munmap(reinterpret_cast<void*>(aligned + chunk_size), start + huge_page_size - aligned);
+        mem = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        if (madvise(mem, chunk_size, MADV_HUGEPAGE) == 0) {
+            huge_page_chunks_++;
+        }
+#endif
+    }
+    chunk = mem;
+#else
+    chunk = std::aligned_alloc(alignof(MachineState), chunk_size);
+    if (!chunk) {
+        throw std::bad_alloc();
+    }
+#endif
+    chunks_.push_back(Chunk{reinterpret_cast<uintptr_t>(chunk), node});
+
+    // hand out low addresses first
+    std::size_t slots = chunk_size / slot_size_;
+    for (std::size_t i = slots; i > 0; i--) {
+        free_[node].push_back(static_cast<uint8_t*>(chunk) + (i - 1) * slot_size_);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef MACHINE_STATE_H
+#define MACHINE_STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "apu_state.h"
+#include "bank_controller.h"
+#include "ppu_state.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "timer_state.h"
+
+// Largest cartridge RAM a header can declare (16 banks of 8 KiB)
+constexpr std::size_t max_cartridge_ram = 0x20000;
+
+/* Machine state arena
+ * Every piece of mutable emulator state in one trivially copyable block, so
+ * copying, snapshotting or hashing a machine is a single bulk memory
+ * operation. The arena is embedded in the CPU (see cpu.h) and the other
+ * components keep references into it. Page tables, I/O and event
+ * handlers, caches and statistics stay outside because they hold host
+ * pointers that differ per machine.
+ *
+ * State touched by nearly every instruction comes first: CPU registers,
+ * cycle counter, mapped ROM bank, scheduler, timer, PPU line position, APU
+ * channel timers, and 0xFF00-0xFFFF (I/O registers, HRAM, IE). Bulk
+ * memory follows, with the cartridge RAM last so a copy can stop where the
+ * cartridge's RAM ends.
+ */
+struct alignas(64) MachineState {
+    /* Hot */
+    CpuState cpu;
+    uint64_t cycles = 0;   // M-cycles (1.048576 MHz) since power on
+    uint16_t rom_bank = 1; // mapped at 0x4000-0x7FFF
+    SchedulerState scheduler;
+    TimerState timer;
+    PpuState ppu;
+    ApuState apu;
+    alignas(64) uint8_t high[0x100] = {};
+
+    /* Cold */
+    BankController mbc;
+    alignas(64) uint8_t memory[0xFF00] = {}; // 0x0000-0xFEFF
+    alignas(64) uint8_t cartridge_ram[max_cartridge_ram] = {};
+
+    // Bytes from the start of the arena up to the end of the first
+    // ram_size bytes of cartridge RAM
+    std::size_t used_bytes(std::size_t ram_size) const {
+        return static_cast<std::size_t>(cartridge_ram - reinterpret_cast<const uint8_t*>(this)) + ram_size;
+    }
+};
+
+static_assert(std::is_trivially_copyable<MachineState>::value, "MachineState must stay memcpy-able");
+
+/* Arena pool
+ * Hands out fixed-size, cache-line aligned slots for objects that embed a
+ * MachineState (the CPU, see cpu.h), carved from large chunks so thousands
+ * of machines share a few allocations. On Linux chunks are 2 MiB aligned
+ * and backed by huge pages when the kernel has them (explicit huge pages
+ * first, then transparent ones), which keeps TLB misses down when many
+ * instances run side by side. Thread safe; the caller constructs into the
+ * slot and destroys before releasing it.
+ *
+ * Every chunk belongs to one NUMA node and only hands out slots to threads
+ * running on that node, and a released slot goes back to its own chunk. So
+ * machines created on different nodes never share a page, and the first
+ * touch of each chunk (constructing into it) places it on the node that
+ * uses it. Without NUMA everything is node 0.
+ */
+class StatePool {
+    public:
+        explicit StatePool(std::size_t slot_size);
+        ~StatePool();
+        StatePool(const StatePool&) = delete;
+        StatePool& operator=(const StatePool&) = delete;
+
+        void* acquire();
+        void release(void* slot);
+
+        std::size_t chunks() const { return chunks_.size(); }
+        std::size_t huge_page_chunks() const { return huge_page_chunks_; } // huge pages requested or advised
+
+    private:
+        static constexpr std::size_t chunk_size = 8 << 20;
+
+        struct Chunk {
+            uintptr_t start;
+            unsigned node;
+        };
+
+        void grow(unsigned node);
+
+        std::size_t slot_size_;
+        std::mutex lock_;
+        std::vector<Chunk> chunks_;
+        std::vector<std::vector<void*>> free_; // by NUMA node
+        std::size_t huge_page_chunks_ = 0;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+class StateError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+};
+
+/* Save state format
+ *   header:  "GBST", u16 version, u8 header checksum and u16 global
+ *            checksum of the cartridge the state belongs to
+ *   section: u32 tag, u32 payload length, payload
+ * All integers are little-endian. Each component writes one section. A
+ * loader skips sections it does not know, so newer builds can add tags,
+ * but rejects a state that lacks any section it writes itself or whose
+ * section has the wrong length: a component it cannot restore would be
+ * left holding the previous machine's state.
+ */
+constexpr uint16_t state_version = 1;
+constexpr std::size_t state_header_size = 9;
+
+constexpr uint32_t state_tag(const char (&name)[5]) {
+    return uint32_t(uint8_t(name[0])) | uint32_t(uint8_t(name[1])) << 8 |
+           uint32_t(uint8_t(name[2])) << 16 | uint32_t(uint8_t(name[3])) << 24;
+}
+
+// Writes into a caller-sized buffer, never allocates
+class StateWriter {
+    public:
+        StateWriter(uint8_t* buffer, std::size_t capacity): buffer_(buffer), capacity_(capacity) {}
+
+        void u8(uint8_t value) { reserve(1); buffer_[size_++] = value; }
+        void u16(uint16_t value) { reserve(2); put(value, 2); }
+        void u32(uint32_t value) { reserve(4); put(value, 4); }
+        void u64(uint64_t value) { reserve(8); put(value, 8); }
+        void boolean(bool value) { u8(value); }
+        void bytes(const void* data, std::size_t length) {
+            reserve(length);
+            std::memcpy(buffer_ + size_, data, length);
+            size_ += length;
+        }
+
+        void begin_section(uint32_t tag) {
+            u32(tag);
+            section_start_ = size_;
+            u32(0);
+        }
+        void end_section() {
+            uint32_t length = static_cast<uint32_t>(size_ - section_start_ - 4);
+            std::size_t end = size_;
+            size_ = section_start_;
+            u32(length);
+            size_ = end;
+        }
+
+        std::size_t size() const { return size_; }
+
+    private:
+        void reserve(std::size_t length) {
+            if (size_ + length > capacity_) {
+                throw StateError("save state buffer too small");
+            }
+        }
+        void put(uint64_t value, int length) {
+            for (int i = 0; i < length; i++) {
+                buffer_[size_++] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        uint8_t* buffer_;
+        std::size_t capacity_;
+        std::size_t size_ = 0;
+        std::size_t section_start_ = 0;
+};
+
+// Reads one section's payload (or a whole state), throws on truncation
+class StateReader {
+    public:
+        StateReader(const uint8_t* data = nullptr, std::size_t size = 0): data_(data), size_(size) {}
+
+        uint8_t u8() { need(1); return data_[pos_++]; }
+        uint16_t u16() { need(2); return static_cast<uint16_t>(get(2)); }
+        uint32_t u32() { need(4); return static_cast<uint32_t>(get(4)); }
+        uint64_t u64() { need(8); return get(8); }
+        bool boolean() { return u8() != 0; }
+        void bytes(void* out, std::size_t length) {
+            need(length);
+            std::memcpy(out, data_ + pos_, length);
+            pos_ += length;
+        }
+        void skip(std::size_t length) {
+            need(length);
+            pos_ += length;
+        }
+
+        // Splits off the next section; false at the end of the data
+        bool next_section(uint32_t& tag, StateReader& payload) {
+            if (pos_ == size_) {
+                return false;
+            }
+            tag = u32();
+            uint32_t length = u32();
+            need(length);
+            payload = StateReader(data_ + pos_, length);
+            pos_ += length;
+            return true;
+        }
+
+        std::size_t remaining() const { return size_ - pos_; }
+
+    private:
+        void need(std::size_t length) const {
+            if (length > size_ - pos_) {
+                throw StateError("save state is truncated");
+            }
+        }
+        uint64_t get(int length) {
+            uint64_t value = 0;
+            for (int i = 0; i < length; i++) {
+                value |= uint64_t(data_[pos_++]) << (8 * i);
+            }
+            return value;
+        }
+
+        const uint8_t* data_;
+        std::size_t size_;
+        std::size_t pos_ = 0;
+};
+
+#endif
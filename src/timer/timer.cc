@@ -0,0 +1,170 @@
+#include "timer.h"
+#include <algorithm>
+
+namespace {
+
+// TIMA counts falling edges of this bit of the M-cycle counter, per TAC
+// rate: 4096, 262144, 65536 and 16384 Hz
+constexpr int tima_bits[4] = { 7, 1, 3, 5 };
+constexpr int div_shift = 6; // DIV ticks at 16384 Hz
+
+// System counter after the boot ROM, in M-cycles
+constexpr uint64_t boot_counter = 0xABCC / 4;
+
+bool timer_enabled(uint8_t tac) {
+    return tac & 0x04;
+}
+
+int edge_shift(uint8_t tac) {
+    return tima_bits[tac & 0x03] + 1;
+}
+
+}
+
+Timer::Timer(MachineState& state, MMU& mmu, Scheduler& scheduler):
+    state_(state),
+    mmu_(mmu),
+    scheduler_(scheduler)
+{
+}
+
+void Timer::connect() {
+    for (uint8_t reg : {io::DIV, io::TIMA, io::TMA, io::TAC}) {
+        bool counts = reg == io::DIV || reg == io::TIMA;
+        mmu_.map_io(0xFF00 | reg, counts ? read_register : nullptr, write_register, this,
+                    counts ? stable_until : nullptr);
+    }
+    scheduler_.set_handler(EventType::Timer, on_event, this);
+}
+
+void Timer::skip_boot_rom() {
+    uint64_t now = state_.cycles;
+    state_.timer.divider_base = now - boot_counter; // may wrap, only differences matter
+    state_.timer.synced = now;
+    state_.high[io::TIMA] = 0x00;
+    state_.high[io::TMA] = 0x00;
+    state_.high[io::TAC] = 0xF8;
+    scheduler_.cancel(EventType::Timer);
+}
+
+/* Registers */
+uint8_t Timer::read_register(void* context, uint16_t address) {
+    Timer& timer = *static_cast<Timer*>(context);
+    uint64_t now = timer.state_.cycles;
+    if ((address & 0xFF) == io::DIV) {
+        return static_cast<uint8_t>(timer.counter(now) >> div_shift);
+    }
+    timer.sync(now);
+    return timer.state_.high[io::TIMA];
+}
+
+// Next DIV tick or TIMA edge
+uint64_t Timer::stable_until(void* context, uint16_t address, uint64_t now) {
+    const Timer& timer = *static_cast<const Timer*>(context);
+    uint8_t tac = timer.state_.high[io::TAC];
+    int shift = div_shift;
+    if ((address & 0xFF) == io::TIMA) {
+        if (!timer_enabled(tac)) {
+            return UINT64_MAX;
+        }
+        shift = edge_shift(tac);
+    }
+    return timer.state_.timer.divider_base + (((timer.counter(now) >> shift) + 1) << shift);
+}
+
+void Timer::write_register(void* context, uint16_t address, uint8_t value) {
+    Timer& timer = *static_cast<Timer*>(context);
+    uint8_t* high = timer.state_.high;
+    uint64_t now = timer.state_.cycles;
+    timer.sync(now);
+    switch (address & 0xFF) {
+        case io::DIV: {
+            // the reset is a falling edge if the selected bit was high
+            bool was_high = timer.signal(high[io::TAC], now);
+            timer.state_.timer.divider_base = now;
+            if (was_high) {
+                timer.increment(1);
+            }
+            break;
+        }
+        case io::TIMA:
+            high[io::TIMA] = value;
+            break;
+        case io::TMA:
+            high[io::TMA] = value;
+            return; // takes effect at the next reload
+        case io::TAC: {
+            bool was_high = timer.signal(high[io::TAC], now);
+            high[io::TAC] = 0xF8 | value;
+            if (was_high && !timer.signal(value, now)) {
+                timer.increment(1);
+            }
+            break;
+        }
+    }
+    timer.schedule_overflow(now);
+}
+
+void Timer::on_event(void* context, uint64_t deadline) {
+    Timer& timer = *static_cast<Timer*>(context);
+    // a read in the same instruction may have synced past the overflow already
+    uint64_t now = std::max(deadline, timer.state_.timer.synced);
+    timer.sync(now);
+    timer.schedule_overflow(now);
+}
+
+/* Counting */
+bool Timer::signal(uint8_t tac, uint64_t now) const {
+    return timer_enabled(tac) && (counter(now) >> tima_bits[tac & 0x03]) & 1;
+}
+
+void Timer::sync(uint64_t now) {
+    TimerState& timer = state_.timer;
+    uint8_t tac = state_.high[io::TAC];
+    if (now <= timer.synced) {
+        return;
+    }
+    if (timer_enabled(tac)) {
+        int shift = edge_shift(tac);
+        increment((counter(now) >> shift) - (counter(timer.synced) >> shift));
+    }
+    timer.synced = now;
+}
+
+// Overflows reload TMA and request the interrupt
+void Timer::increment(uint64_t edges) {
+    uint8_t* high = state_.high;
+    while (edges) {
+        uint64_t to_overflow = 0x100 - high[io::TIMA];
+        if (edges < to_overflow) {
+            high[io::TIMA] = static_cast<uint8_t>(high[io::TIMA] + edges);
+            return;
+        }
+        edges -= to_overflow;
+        high[io::TIMA] = high[io::TMA];
+        high[io::IF] |= interrupt::timer;
+    }
+}
+
+void Timer::schedule_overflow(uint64_t now) {
+    uint8_t tac = state_.high[io::TAC];
+    if (!timer_enabled(tac)) {
+        scheduler_.cancel(EventType::Timer);
+        return;
+    }
+    int shift = edge_shift(tac);
+    uint64_t edges = 0x100 - state_.high[io::TIMA];
+    uint64_t overflow_edge = ((counter(now) >> shift) + edges) << shift;
+    scheduler_.schedule(EventType::Timer, state_.timer.divider_base + overflow_edge);
+}
+
+/* Save states */
+void Timer::save_state(StateWriter& out) const {
+    out.u64(state_.timer.divider_base);
+    out.u64(state_.timer.synced);
+}
+
+void Timer::load_state(StateReader& in) {
+    state_.timer.divider_base = in.u64();
+    state_.timer.synced = in.u64();
+}
@@ -0,0 +1,61 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <cstdint>
+#include "io_registers.h"
+#include "machine_state.h"
+#include "mmu.h"
+#include "scheduler.h"
+#include "state.h"
+
+/* Timer
+ * DIV is the upper byte of a free-running system counter and TIMA counts
+ * falling edges of the counter bit TAC selects. Neither is stepped: the
+ * counter is the cycle count since divider_base, DIV reads shift it, and
+ * TIMA is brought up to date from the number of edges since the last
+ * sync whenever it is read or a timer register is written. The TIMA
+ * overflow is a scheduler event at the exact cycle of the 256th edge,
+ * which reloads TMA and requests the timer interrupt.
+ *
+ * The falling-edge quirks fall out of the same model: resetting DIV, or a
+ * TAC write that disables the timer or moves it to a bit that is low,
+ * ticks TIMA when the selected bit was high. TIMA reloads in the cycle it
+ * overflows; the hardware's one cycle of reading 0 first is not modelled.
+ */
+class Timer {
+    public:
+        Timer(MachineState& state, MMU& mmu, Scheduler& scheduler);
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        // Claims DIV, TIMA, TMA, TAC and the timer event
+        void connect();
+
+        // DIV as the boot ROM leaves it, timer stopped
+        void skip_boot_rom();
+
+        // "TIMR" section
+        void save_state(StateWriter& out) const;
+        void load_state(StateReader& in);
+
+    private:
+        static uint8_t read_register(void* context, uint16_t address);
+        static uint64_t stable_until(void* context, uint16_t address, uint64_t now);
+        static void write_register(void* context, uint16_t address, uint8_t value);
+        static void on_event(void* context, uint64_t deadline);
+
+        uint64_t counter(uint64_t now) const { return now - state_.timer.divider_base; }
+
+        // Counts the TIMA edges up to now
+        void sync(uint64_t now);
+        void increment(uint64_t edges);
+        // TIMA input: enabled and the selected counter bit high
+        bool signal(uint8_t tac, uint64_t now) const;
+        void schedule_overflow(uint64_t now);
+
+        MachineState& state_;
+        MMU& mmu_;
+        Scheduler& scheduler_;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef TIMER_STATE_H
+#define TIMER_STATE_H
+
+#include <cstdint>
+
+// Divider and TIMA bookkeeping, kept in the machine state arena. TIMA,
+// TMA and TAC sit in MachineState::high; DIV there is stale, reads work
+// it out from the cycle counter.
+struct TimerState {
+    uint64_t divider_base = 0;  // cycle the system counter was last 0
+    uint64_t synced = 0;        // TIMA in high[] is current up to here
+};
+
+#endif